@@ -0,0 +1,136 @@
+#include "allocation-counter.h"
+
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions, the array and nothrow forms
+// as well, so every allocation of the process goes through AllocationCounter.
+// Aligned allocations get their own functions, the heap can't free them otherwise.
+#ifdef QUICK_FOLDER_COUNT_ALLOCATIONS
+
+namespace {
+    void* allocate(const std::size_t size) noexcept {
+        AllocationCounter::countAllocation(size);
+        return std::malloc(size ? size : 1);
+    }
+
+    void* allocate(const std::size_t size, const std::align_val_t alignment) noexcept {
+        AllocationCounter::countAllocation(size);
+        const auto alignmentBytes{ static_cast<std::size_t>(alignment) };
+#ifdef _WIN32
+        return ::_aligned_malloc(size ? size : 1, alignmentBytes);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(alignmentBytes, (size + alignmentBytes - 1) / alignmentBytes * alignmentBytes);
+#endif
+    }
+
+    void deallocate(void* const memory) noexcept {
+        if (!memory)
+            return;
+
+        AllocationCounter::countDeallocation();
+        std::free(memory);
+    }
+
+    void deallocateAligned(void* const memory) noexcept {
+        if (!memory)
+            return;
+
+        AllocationCounter::countDeallocation();
+#ifdef _WIN32
+        ::_aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+
+    template<typename... Alignment>
+    void* allocateOrThrow(const std::size_t size, const Alignment... alignment) {
+        if (const auto memory{ allocate(size, alignment...) })
+            return memory;
+
+        throw std::bad_alloc{};
+    }
+}
+
+void* operator new(const std::size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new[](const std::size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment) {
+    return allocateOrThrow(size, alignment);
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment) {
+    return allocateOrThrow(size, alignment);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+void operator delete(void* const memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void* const memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* const memory, std::size_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void* const memory, std::size_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* const memory, const std::nothrow_t&) noexcept {
+    deallocate(memory);
+}
+
+void operator delete[](void* const memory, const std::nothrow_t&) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* const memory, std::align_val_t) noexcept {
+    deallocateAligned(memory);
+}
+
+void operator delete[](void* const memory, std::align_val_t) noexcept {
+    deallocateAligned(memory);
+}
+
+void operator delete(void* const memory, std::size_t, std::align_val_t) noexcept {
+    deallocateAligned(memory);
+}
+
+void operator delete[](void* const memory, std::size_t, std::align_val_t) noexcept {
+    deallocateAligned(memory);
+}
+
+void operator delete(void* const memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    deallocateAligned(memory);
+}
+
+void operator delete[](void* const memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    deallocateAligned(memory);
+}
+#endif
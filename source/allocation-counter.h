@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+// Counts every allocation made through the global operator new and delete,
+// which allocation-counter.cpp replaces, so std containers, pmr resources
+// and everything else on the heap are seen. The operators are only replaced when
+// built with QUICK_FOLDER_COUNT_ALLOCATIONS, as Debug and the replay harness are,
+// otherwise counts stay 0 and release builds allocate straight from the heap.
+// Allocations are reported per phase of a session for the whole process,
+// and per key press from the counts of the thread handling it, so roots
+// still loading on other threads aren't blamed on the key.
+class AllocationCounter {
+public:
+    struct Counts {
+        std::uint64_t allocations{};
+        std::uint64_t deallocations{};
+        std::uint64_t allocatedBytes{};
+
+        Counts operator-(const Counts& other) const {
+            return {
+                .allocations{ allocations - other.allocations },
+                .deallocations{ deallocations - other.deallocations },
+                .allocatedBytes{ allocatedBytes - other.allocatedBytes },
+            };
+        }
+
+        Counts& operator+=(const Counts& other) {
+            allocations += other.allocations;
+            deallocations += other.deallocations;
+            allocatedBytes += other.allocatedBytes;
+            return *this;
+        }
+    };
+
+#ifdef QUICK_FOLDER_COUNT_ALLOCATIONS
+    static constexpr bool isEnabled{ true };
+#else
+    static constexpr bool isEnabled{ false };
+#endif
+
+    AllocationCounter() {
+        m_phases.reserve(maxPhases);
+    }
+
+    // Of every thread
+    static Counts getCounts() noexcept {
+        return {
+            .allocations{ s_allocations.load(std::memory_order_relaxed) },
+            .deallocations{ s_deallocations.load(std::memory_order_relaxed) },
+            .allocatedBytes{ s_allocatedBytes.load(std::memory_order_relaxed) },
+        };
+    }
+
+    // Of the calling thread alone
+    static Counts getThreadCounts() noexcept {
+        return s_threadCounts;
+    }
+
+    // Only called from the replaced operators, which can't allocate
+    static void countAllocation(const std::size_t bytes) noexcept {
+        s_allocations.fetch_add(1, std::memory_order_relaxed);
+        s_allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        ++s_threadCounts.allocations;
+        s_threadCounts.allocatedBytes += bytes;
+    }
+
+    static void countDeallocation() noexcept {
+        s_deallocations.fetch_add(1, std::memory_order_relaxed);
+        ++s_threadCounts.deallocations;
+    }
+
+    // Ends the phase that started with the previous call, or with the counter.
+    // name has to outlive the counter, phases after the first maxPhases are dropped.
+    void endPhase(const std::string_view name) {
+        const auto counts{ getCounts() };
+        if (m_phases.size() < maxPhases) {
+            m_phases.push_back({ .name{ name }, .counts{ counts - m_phaseStart } });
+        }
+        m_phaseStart = counts;
+    }
+
+    void writeReport(std::ostream& stream) const {
+        stream << "phase\tallocations\tdeallocations\tallocated_bytes\n";
+        for (const auto& phase : m_phases) {
+            stream << phase.name
+                << '\t' << phase.counts.allocations
+                << '\t' << phase.counts.deallocations
+                << '\t' << phase.counts.allocatedBytes
+                << '\n';
+        }
+    }
+
+private:
+    static constexpr std::size_t maxPhases{ 16 };
+
+    struct Phase {
+        std::string_view name{};
+        Counts counts{};
+    };
+
+    // Zero before any constructor runs, so allocations of static initialization are counted
+    static inline std::atomic<std::uint64_t> s_allocations{};
+    static inline std::atomic<std::uint64_t> s_deallocations{};
+    static inline std::atomic<std::uint64_t> s_allocatedBytes{};
+    static thread_local Counts s_threadCounts;
+
+    // Only touched by the thread ending phases
+    std::vector<Phase> m_phases{};
+    Counts m_phaseStart{ getCounts() };
+};
+
+inline thread_local AllocationCounter::Counts AllocationCounter::s_threadCounts{};
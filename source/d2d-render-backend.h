@@ -0,0 +1,149 @@
+#pragma once
+
+#include "render-backend.h"
+#include "utf8.h"
+
+#define NOMINMAX
+#include <Windows.h>
+#include <d2d1.h>
+#include <dwrite.h>
+#include <wrl.h>
+
+#include <string>
+#include <string_view>
+
+namespace wrl = Microsoft::WRL;
+
+// Draws to a window with Direct2D and measures with DirectWrite
+class D2DRenderBackend : public RenderBackend, public TextMeasurer {
+public:
+    D2DRenderBackend(const ::HWND window, const float fontSize, const float backgroundTint)
+        : m_backgroundTintColor{ D2D1::ColorF(0.f, 0.f, 0.f, backgroundTint) }
+    {
+        ::D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, m_factory.GetAddressOf());
+
+        m_factory->CreateHwndRenderTarget(
+            D2D1::RenderTargetProperties(
+                D2D1_RENDER_TARGET_TYPE_DEFAULT,
+                D2D1::PixelFormat(DXGI_FORMAT_UNKNOWN, D2D1_ALPHA_MODE_PREMULTIPLIED)
+            ),
+            D2D1::HwndRenderTargetProperties(window),
+            &m_renderTarget
+        );
+        m_renderTarget->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+
+        m_renderTarget->CreateSolidColorBrush(
+            D2D1::ColorF(D2D1::ColorF::White), &m_whiteBrush
+        );
+        m_renderTarget->CreateSolidColorBrush(
+            D2D1::ColorF(D2D1::ColorF::Yellow), &m_yellowBrush
+        );
+        m_renderTarget->CreateSolidColorBrush(
+            D2D1::ColorF(1.f, .5f, 0.f, 1.f), &m_orangeBrush
+        );
+        m_renderTarget->CreateSolidColorBrush(
+            D2D1::ColorF(.6f, .6f, .6f, 1.f), &m_grayBrush
+        );
+
+        ::DWriteCreateFactory(
+            DWRITE_FACTORY_TYPE_SHARED,
+            __uuidof(::IDWriteFactory),
+            reinterpret_cast<::IUnknown**>(m_writeFactory.GetAddressOf())
+        );
+
+        m_writeFactory->CreateTextFormat(
+            L"Arial",
+            NULL,
+            DWRITE_FONT_WEIGHT_NORMAL,
+            DWRITE_FONT_STYLE_NORMAL,
+            DWRITE_FONT_STRETCH_NORMAL,
+            fontSize,
+            L"pl-PL",
+            &m_textFormat
+        );
+        m_textFormat->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
+    }
+
+    void beginFrame() override {
+        m_renderTarget->BeginDraw();
+        m_renderTarget->Clear(m_backgroundTintColor);
+    }
+
+    // TODO: Might want to switch to DrawTextLayout,
+    // because this creates a text layout every time it's called.
+    // We could reuse them if the user presses arrow down or up
+    // Also consider just drawing the whole text with one draw call
+    // by caching it in the parent node.
+    void drawText(const std::string_view text, const TextArea& area, const TextStyle style) override {
+        utf8::toWide(text, m_wideText);
+        m_renderTarget->DrawText(
+            m_wideText.data(),
+            static_cast<::UINT32>(m_wideText.size()),
+            m_textFormat.Get(),
+            D2D1::RectF(area.left, area.top, area.right, area.bottom),
+            getBrush(style)
+        );
+    }
+
+    void endFrame() override {
+        m_renderTarget->EndDraw();
+    }
+
+    void clear() override {
+        m_renderTarget->BeginDraw();
+        m_renderTarget->Clear(m_backgroundTintColor);
+        m_renderTarget->EndDraw();
+    }
+
+    void resize(const int width, const int height) override {
+        m_renderTarget->Resize(D2D1::SizeU(
+            static_cast<unsigned int>(width),
+            static_cast<unsigned int>(height)
+        ));
+    }
+
+    TextSize measureText(const std::string_view text) override {
+        utf8::toWide(text, m_wideText);
+        wrl::ComPtr<::IDWriteTextLayout> textLayout{};
+        m_writeFactory->CreateTextLayout(
+            m_wideText.data(),
+            static_cast<::UINT32>(m_wideText.size()),
+            m_textFormat.Get(),
+            0.f,
+            0.f,
+            &textLayout
+        );
+
+        ::DWRITE_TEXT_METRICS textMetrics{};
+        textLayout->GetMetrics(&textMetrics);
+        return { .width{ textMetrics.width }, .height{ textMetrics.height } };
+    }
+
+private:
+    ::ID2D1SolidColorBrush* getBrush(const TextStyle style) const {
+        switch (style) {
+        case TextStyle::Stale:
+            return m_grayBrush.Get();
+        case TextStyle::Selected:
+            return m_yellowBrush.Get();
+        case TextStyle::SelectedLeaf:
+            return m_orangeBrush.Get();
+        default:
+            return m_whiteBrush.Get();
+        }
+    }
+
+    const ::D2D1_COLOR_F m_backgroundTintColor{};
+
+    wrl::ComPtr<::ID2D1Factory> m_factory{};
+    wrl::ComPtr<::ID2D1HwndRenderTarget> m_renderTarget{};
+    wrl::ComPtr<::ID2D1SolidColorBrush> m_whiteBrush{};
+    wrl::ComPtr<::ID2D1SolidColorBrush> m_yellowBrush{};
+    wrl::ComPtr<::ID2D1SolidColorBrush> m_orangeBrush{};
+    wrl::ComPtr<::ID2D1SolidColorBrush> m_grayBrush{};
+    wrl::ComPtr<::IDWriteFactory> m_writeFactory{};
+    wrl::ComPtr<::IDWriteTextFormat> m_textFormat{};
+
+    // DirectWrite takes UTF-16, reused so drawing a frame doesn't allocate
+    std::wstring m_wideText{};
+};
@@ -0,0 +1,368 @@
+#pragma once
+
+#include "directory-utils.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Answers which node of the tree covers a path, e.g. C:\Users\me\Desktop\notes.txt
+// is covered by the node of C:\Users\me if nothing deeper is in the tree.
+// Every path component in the tree is interned once, and every step down the
+// tree is a hash lookup of the parent and the interned component, so a path is
+// resolved in one hash lookup per component, independent of the fanout.
+// Names of flattened nodes like C:\Users span several steps.
+// It holds no pointers into the tree, entries give back the full path of their
+// node for DirectoryNavigator::findNode. Rebuilding costs more than a few findNode
+// walks, so it's only rebuilt once queried after the tree generation moved.
+class DirectoryQueryIndex {
+public:
+    static constexpr std::uint32_t noEntry{ std::numeric_limits<std::uint32_t>::max() };
+    static constexpr std::uint64_t noGeneration{ std::numeric_limits<std::uint64_t>::max() };
+
+    struct Resolution {
+        // Deepest node the path is in or equal to, noEntry if none
+        std::uint32_t entry{ noEntry };
+        std::uint32_t matchedComponents{};
+        bool isExact{};
+    };
+
+    // Rebuilds from root unless it's built from treeGeneration already, see
+    // DirectoryNavigator::getTreeGeneration. True if rebuilt, entries from before
+    // then belong to other paths.
+    bool update(const DirectoryNode& root, const std::uint64_t treeGeneration) {
+        if (m_generation == treeGeneration)
+            return false;
+
+        build(root);
+        m_generation = treeGeneration;
+        return true;
+    }
+
+    // noGeneration until update is called
+    std::uint64_t getGeneration() const {
+        return m_generation;
+    }
+
+    void build(const DirectoryNode& root) {
+        m_generation = noGeneration;
+        m_steps.clear();
+        m_children.clear();
+        m_componentNames.clear();
+        m_components.clear();
+
+        m_componentSlots.assign(minTableSize, { .value{ noEntry } });
+        m_stepSlots.assign(minTableSize, { .value{ noEntry } });
+
+        // A single drive flattened into the top node comes before every child,
+        // the top node itself isn't an entry as findNode doesn't find it
+        m_steps.push_back({ .parent{ noEntry } });
+        std::uint32_t top{};
+        forEachComponent(root.getFullPath(), [&](const std::string_view component) {
+            top = addStep(top, internComponent(component));
+            return true;
+        });
+        addChildren(root, top);
+
+        // Grown by doubling while building, the index is read-only afterwards
+        m_steps.shrink_to_fit();
+        m_children.shrink_to_fit();
+    }
+
+    Resolution resolve(const std::string_view path) const {
+        Resolution resolution{};
+        if (m_steps.empty())
+            return resolution;
+
+        std::uint32_t step{};
+        std::uint32_t depth{};
+        bool isExact{ true };
+        forEachComponent(path, [&](const std::string_view name) {
+            const auto component{ findComponent(name) };
+            const auto next{ component == noEntry ? noEntry : findStep(step, component) };
+            if (next == noEntry) {
+                isExact = false;
+                return false;
+            }
+
+            step = next;
+            ++depth;
+            if (m_steps[step].isNode) {
+                resolution.entry = step;
+                resolution.matchedComponents = depth;
+            }
+            return true;
+        });
+
+        resolution.isExact = isExact && resolution.entry == step && resolution.entry != noEntry;
+        return resolution;
+    }
+
+    // results has to be as long as paths
+    void resolve(const std::span<const std::string_view> paths, const std::span<Resolution> results) const {
+        const auto count{ std::min(paths.size(), results.size()) };
+        for (std::size_t i{}; i < count; ++i) {
+            results[i] = resolve(paths[i]);
+        }
+    }
+
+    // As DirectoryNode::getFullPath gives it, names in the case of the tree
+    void appendFullPath(const std::uint32_t entry, std::string& path) const {
+        const auto start{ path.size() };
+        std::size_t length{};
+        for (auto step{ entry }; step; step = m_steps[step].parent) {
+            length += m_components[m_steps[step].component].nameLength + 1;
+        }
+
+        path.resize(start + length);
+        auto end{ path.size() };
+        for (auto step{ entry }; step; step = m_steps[step].parent) {
+            const auto name{ getComponentName(m_steps[step].component) };
+            path[--end] = '\\';
+            end -= name.length();
+            path.replace(end, name.length(), name);
+        }
+    }
+
+    // Entries of the children of the node, in the order of its children
+    std::span<const std::uint32_t> getChildren(const std::uint32_t entry) const {
+        const auto& step{ m_steps[entry] };
+        return std::span{ m_children }.subspan(step.firstChild, step.childCount);
+    }
+
+    std::size_t getComponentCount() const {
+        return m_components.size();
+    }
+
+    std::size_t getMemoryUsage() const {
+        return sizeof(*this)
+            + m_steps.capacity() * sizeof(Step)
+            + m_children.capacity() * sizeof(std::uint32_t)
+            + m_componentNames.capacity()
+            + m_components.capacity() * sizeof(Component)
+            + m_componentSlots.capacity() * sizeof(ComponentSlot)
+            + m_stepSlots.capacity() * sizeof(StepSlot);
+    }
+
+private:
+    // Nodes are the last step of their name, the steps before belong to no node
+    struct Step {
+        std::uint32_t parent{};
+        std::uint32_t component{};
+        std::uint32_t firstChild{};
+        std::uint32_t childCount{};
+        bool isNode{};
+    };
+
+    // Names differing only in case are looked up as the first of them,
+    // the others are kept so paths are given back as the tree has them
+    struct Component {
+        std::uint32_t nameOffset{};
+        std::uint32_t nameLength{};
+        std::uint32_t firstVariant{};
+        std::uint32_t nextVariant{ noEntry };
+    };
+
+    // Both tables use open addressing with linear probing and stay at most 70% full,
+    // value is noEntry for empty slots
+    struct ComponentSlot {
+        std::uint32_t hash{};
+        std::uint32_t value{};
+    };
+
+    struct StepSlot {
+        std::uint32_t parent{};
+        std::uint32_t component{};
+        std::uint32_t value{};
+    };
+
+    static constexpr std::size_t minTableSize{ 64 };
+
+    template<typename Callback>
+    static void forEachComponent(std::string_view path, const Callback& callback) {
+        while (!path.empty()) {
+            const auto separator{ path.find_first_of("\\/") };
+            const auto name{ path.substr(0, separator) };
+            if (!name.empty() && !callback(name))
+                return;
+
+            path.remove_prefix(separator == std::string_view::npos ? path.size() : separator + 1);
+        }
+    }
+
+    // Differing only in case is the same component where the file system says so
+    static std::uint32_t hashComponent(const std::string_view name) noexcept {
+        std::uint32_t hash{ 2166136261u };
+        if constexpr (DirectoryNode::isFileSystemCaseInsensitive) {
+            for (std::size_t pos{}; pos < name.size();) {
+                hash = (hash ^ utf8::foldCodePoint(utf8::decode(name, pos))) * 16777619u;
+            }
+        } else {
+            for (const char character : name) {
+                hash = (hash ^ static_cast<unsigned char>(character)) * 16777619u;
+            }
+        }
+        return hash;
+    }
+
+    static bool isSameComponent(const std::string_view lhs, const std::string_view rhs) noexcept {
+        if constexpr (DirectoryNode::isFileSystemCaseInsensitive) {
+            return utf8::equalsIgnoringCase(lhs, rhs);
+        } else {
+            return lhs == rhs;
+        }
+    }
+
+    static std::size_t hashStep(const std::uint32_t parent, const std::uint32_t component) noexcept {
+        const auto key{ static_cast<std::uint64_t>(parent) << 32 | component };
+        return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+    static bool isFull(const std::size_t count, const std::size_t tableSize) noexcept {
+        return count * 10 >= tableSize * 7;
+    }
+
+    std::string_view getComponentName(const std::uint32_t component) const {
+        const auto& data{ m_components[component] };
+        return std::string_view{ m_componentNames }.substr(data.nameOffset, data.nameLength);
+    }
+
+    std::uint32_t findComponent(const std::string_view name) const {
+        const auto hash{ hashComponent(name) };
+        const auto mask{ m_componentSlots.size() - 1 };
+        for (auto slot{ hash & mask };; slot = (slot + 1) & mask) {
+            const auto& entry{ m_componentSlots[slot] };
+            if (entry.value == noEntry)
+                return noEntry;
+            if (entry.hash == hash && isSameComponent(getComponentName(entry.value), name))
+                return entry.value;
+        }
+    }
+
+    std::uint32_t internComponent(const std::string_view name) {
+        if (const auto first{ findComponent(name) }; first != noEntry) {
+            auto last{ first };
+            for (auto variant{ first }; variant != noEntry; variant = m_components[variant].nextVariant) {
+                if (getComponentName(variant) == name)
+                    return variant;
+
+                last = variant;
+            }
+
+            const auto component{ appendComponent(name, first) };
+            m_components[last].nextVariant = component;
+            return component;
+        }
+
+        const auto component{ appendComponent(name, static_cast<std::uint32_t>(m_components.size())) };
+
+        if (isFull(m_components.size(), m_componentSlots.size())) {
+            std::vector<ComponentSlot> slots(m_componentSlots.size() * 2, { .value{ noEntry } });
+            std::swap(slots, m_componentSlots);
+            for (const auto& slot : slots) {
+                if (slot.value != noEntry) {
+                    insertComponentSlot(slot);
+                }
+            }
+        }
+        insertComponentSlot({ .hash{ hashComponent(name) }, .value{ component } });
+        return component;
+    }
+
+    std::uint32_t appendComponent(const std::string_view name, const std::uint32_t firstVariant) {
+        const auto component{ static_cast<std::uint32_t>(m_components.size()) };
+        m_components.push_back({
+            .nameOffset{ static_cast<std::uint32_t>(m_componentNames.size()) },
+            .nameLength{ static_cast<std::uint32_t>(name.size()) },
+            .firstVariant{ firstVariant },
+        });
+        m_componentNames += name;
+        return component;
+    }
+
+    void insertComponentSlot(const ComponentSlot entry) {
+        const auto mask{ m_componentSlots.size() - 1 };
+        auto slot{ entry.hash & mask };
+        while (m_componentSlots[slot].value != noEntry) {
+            slot = (slot + 1) & mask;
+        }
+        m_componentSlots[slot] = entry;
+    }
+
+    std::uint32_t findStep(const std::uint32_t parent, const std::uint32_t component) const {
+        const auto mask{ m_stepSlots.size() - 1 };
+        for (auto slot{ hashStep(parent, component) & mask };; slot = (slot + 1) & mask) {
+            const auto& entry{ m_stepSlots[slot] };
+            if (entry.value == noEntry || (entry.parent == parent && entry.component == component))
+                return entry.value;
+        }
+    }
+
+    // The step keeps component as given, it's found by the first variant
+    std::uint32_t addStep(const std::uint32_t parent, const std::uint32_t component) {
+        const auto firstVariant{ m_components[component].firstVariant };
+        if (const auto step{ findStep(parent, firstVariant) }; step != noEntry)
+            return step;
+
+        const auto step{ static_cast<std::uint32_t>(m_steps.size()) };
+        m_steps.push_back({ .parent{ parent }, .component{ component } });
+
+        if (isFull(m_steps.size(), m_stepSlots.size())) {
+            std::vector<StepSlot> slots(m_stepSlots.size() * 2, { .value{ noEntry } });
+            std::swap(slots, m_stepSlots);
+            for (const auto& slot : slots) {
+                if (slot.value != noEntry) {
+                    insertStepSlot(slot);
+                }
+            }
+        }
+        insertStepSlot({ .parent{ parent }, .component{ firstVariant }, .value{ step } });
+        return step;
+    }
+
+    void insertStepSlot(const StepSlot entry) {
+        const auto mask{ m_stepSlots.size() - 1 };
+        auto slot{ hashStep(entry.parent, entry.component) & mask };
+        while (m_stepSlots[slot].value != noEntry) {
+            slot = (slot + 1) & mask;
+        }
+        m_stepSlots[slot] = entry;
+    }
+
+    void addChildren(const DirectoryNode& node, const std::uint32_t parentStep) {
+        const auto firstChild{ static_cast<std::uint32_t>(m_children.size()) };
+        m_children.resize(m_children.size() + node.getChildCount());
+
+        auto childSlot{ firstChild };
+        for (const auto& [name, child] : node.getChildren()) {
+            auto step{ parentStep };
+            forEachComponent(name, [&](const std::string_view component) {
+                step = addStep(step, internComponent(component));
+                return true;
+            });
+
+            m_steps[step].isNode = true;
+            m_children[childSlot++] = step;
+            addChildren(child, step);
+        }
+
+        m_steps[parentStep].firstChild = firstChild;
+        m_steps[parentStep].childCount = static_cast<std::uint32_t>(node.getChildCount());
+    }
+
+    std::uint64_t m_generation{ noGeneration };
+
+    std::vector<Step> m_steps{};
+    std::vector<std::uint32_t> m_children{};
+
+    std::string m_componentNames{};
+    std::vector<Component> m_components{};
+
+    std::vector<ComponentSlot> m_componentSlots{};
+    std::vector<StepSlot> m_stepSlots{};
+};
@@ -0,0 +1,1220 @@
+#pragma once
+
+#include "directory-utils.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUICK_FOLDER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace search {
+
+// Lowercases UTF-8 text into out. ASCII is folded 16 bytes at a time,
+// other characters one at a time and only when the folded character
+// takes as many bytes, so offsets into out are offsets into text.
+inline void foldCase(const std::string_view text, char* const out) noexcept {
+    std::size_t i{};
+    std::size_t firstNonAscii{ text.size() };
+
+#ifdef QUICK_FOLDER_SSE2
+    // Bytes of multibyte characters are negative, so never between A and Z
+    const __m128i beforeA{ _mm_set1_epi8('A' - 1) };
+    const __m128i afterZ{ _mm_set1_epi8('Z' + 1) };
+    const __m128i caseBit{ _mm_set1_epi8(0x20) };
+
+    for (; i + 16 <= text.size(); i += 16) {
+        const __m128i block{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i)) };
+        if (firstNonAscii == text.size() && _mm_movemask_epi8(block)) {
+            firstNonAscii = i;
+        }
+
+        const __m128i isUpper{ _mm_and_si128(_mm_cmpgt_epi8(block, beforeA), _mm_cmpgt_epi8(afterZ, block)) };
+        const __m128i folded{ _mm_or_si128(block, _mm_and_si128(isUpper, caseBit)) };
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), folded);
+    }
+#endif
+
+    for (; i < text.size(); ++i) {
+        const char byte{ text[i] };
+        if (static_cast<unsigned char>(byte) >= 0x80 && firstNonAscii == text.size()) {
+            firstNonAscii = i;
+        }
+        out[i] = byte >= 'A' && byte <= 'Z' ? static_cast<char>(byte + 0x20) : byte;
+    }
+
+    for (std::size_t pos{ firstNonAscii }; pos < text.size();) {
+        if (static_cast<unsigned char>(text[pos]) < 0x80) {
+            ++pos;
+            continue;
+        }
+
+        const auto start{ pos };
+        char folded[4]{};
+        const auto foldedLength{ utf8::encode(utf8::foldCodePoint(utf8::decode(text, pos)), folded) };
+        if (foldedLength == pos - start) {
+            std::memcpy(out + start, folded, foldedLength);
+        }
+    }
+}
+
+// Finds needle in haystack, both have to be folded already.
+// Candidate positions are found by comparing the first byte
+// of the needle with a whole block of the haystack at once.
+// The first byte never continues a character, so matches start on one.
+inline std::size_t find(const std::string_view haystack, const std::string_view needle) noexcept {
+    if (needle.empty())
+        return 0;
+    if (needle.size() > haystack.size())
+        return std::string_view::npos;
+
+    const std::size_t lastStart{ haystack.size() - needle.size() };
+    const auto matchesAt{ [&](const std::size_t pos) {
+        return std::memcmp(haystack.data() + pos + 1, needle.data() + 1, needle.size() - 1) == 0;
+    } };
+
+    std::size_t pos{};
+
+#ifdef QUICK_FOLDER_SSE2
+    const __m128i first{ _mm_set1_epi8(needle.front()) };
+
+    for (; pos + 16 <= lastStart + 1; pos += 16) {
+        const __m128i block{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack.data() + pos)) };
+        auto mask{ static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, first))) };
+        while (mask) {
+            const auto offset{ static_cast<std::size_t>(std::countr_zero(mask)) };
+            if (matchesAt(pos + offset))
+                return pos + offset;
+
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; pos <= lastStart; ++pos) {
+        if (haystack[pos] == needle.front() && matchesAt(pos))
+            return pos;
+    }
+    return std::string_view::npos;
+}
+
+// Advances through needle for every character of haystack that matches,
+// returns how many bytes of the needle were consumed
+inline std::size_t matchSubsequence(
+    const std::string_view haystack,
+    const std::string_view needle,
+    std::size_t consumed = 0
+) noexcept {
+    for (std::size_t pos{}; pos < haystack.size() && consumed < needle.size();) {
+        const auto length{ utf8::getSequenceLength(haystack[pos]) };
+        if (haystack.compare(pos, length, needle, consumed, length) == 0) {
+            consumed += length;
+        }
+        pos += length;
+    }
+    return consumed;
+}
+
+}
+
+// Flat index of every node in a frozen tree, used for searching
+// the whole tree at once instead of level by level.
+// Candidates come from posting lists of node names, by the first bytes
+// of the name and of its words, by single bytes, bigrams and trigrams,
+// and are then verified against the folded names of the whole path.
+// Lists are ordered by how much depth and name length cost a score,
+// so a search stops as soon as no later candidate can reach the results.
+// Every root, a child of the top node, is indexed in a segment of its own,
+// so a root read again is indexed without the rest of the tree.
+// Only the tree in memory has postings, a few names of evicted levels are kept apart.
+class DirectorySearchIndex {
+public:
+    static constexpr std::size_t maxDepth{ 128 };
+
+    // Valid until the index changes
+    struct EntryId {
+        std::uint32_t segment{};
+        std::uint32_t entry{};
+    };
+
+    // Equal scores go to shallower nodes and shorter names first, that's the rank key,
+    // then to earlier roots and then by rank within the root
+    struct Result {
+        EntryId entry{};
+        int score{};
+        std::uint32_t rankKey{};
+        std::uint32_t rank{};
+    };
+
+    // Indexes every child of root, only what's in the tree gets postings. Names of levels
+    // evicted since the previous build are kept on their own, as many as fit in the limit.
+    // Search still finds them by checking each one and selecting one reads its level again.
+    void build(const DirectoryNode& root) {
+        PostingsScratch scratch{};
+        std::vector<Segment> segments{};
+        segments.reserve(root.getChildCount());
+        auto evictedNameLimit{ m_evictedNameLimit };
+        for (const auto& [name, child] : root.getChildren()) {
+            const auto previous{ findSegment(name) };
+            segments.push_back(buildSegment(child, previous == m_segments.end() ? nullptr : &*previous, evictedNameLimit, scratch));
+            evictedNameLimit -= std::min(segments.back().getEvictedNameBytes(), evictedNameLimit);
+        }
+        m_segments = std::move(segments);
+        m_topPath = root.getFullPath();
+        m_foldedTopPath.resize(m_topPath.size());
+        search::foldCase(m_topPath, m_foldedTopPath.data());
+    }
+
+    // Indexes a root again once it was replaced or changed, evicted names are kept like in build
+    void updateRoot(const DirectoryNode& root) {
+        PostingsScratch scratch{};
+        const auto segment{ findSegment(root.getName()) };
+        if (segment == m_segments.end()) {
+            m_segments.insert(lowerBound(root.getName()), buildSegment(root, nullptr, 0, scratch));
+            return;
+        }
+
+        const auto otherBytes{ getEvictedNameBytes() - segment->getEvictedNameBytes() };
+        const auto evictedNameLimit{ m_evictedNameLimit - std::min(otherBytes, m_evictedNameLimit) };
+        *segment = buildSegment(root, &*segment, evictedNameLimit, scratch);
+    }
+
+    // Bytes the names of evicted levels can take in total, none are kept without it
+    void setEvictedNameLimit(const std::size_t bytes) {
+        m_evictedNameLimit = bytes;
+    }
+
+    // Part of getMemoryUsage
+    std::size_t getEvictedNameBytes() const {
+        std::size_t size{};
+        for (const auto& segment : m_segments) {
+            size += segment.getEvictedNameBytes();
+        }
+        return size;
+    }
+
+    void removeRoot(const std::string_view name) {
+        if (const auto segment{ findSegment(name) }; segment != m_segments.end()) {
+            m_segments.erase(segment);
+        }
+    }
+
+    std::size_t getEntryCount() const {
+        std::size_t count{};
+        for (const auto& segment : m_segments) {
+            count += segment.entries.size();
+        }
+        return count;
+    }
+
+    std::size_t getMemoryUsage() const {
+        std::size_t size{ sizeof(*this) + m_segments.capacity() * sizeof(Segment) + m_topPath.capacity() + m_foldedTopPath.capacity() };
+        for (const auto& segment : m_segments) {
+            size += segment.getMemoryUsage();
+        }
+        return size;
+    }
+
+    std::string_view getName(const EntryId entry) const {
+        const auto& segment{ m_segments[entry.segment] };
+        if (const auto evictedName{ getEvictedName(entry) }; evictedName != noParent) {
+            const auto path{ segment.getEvictedPath(evictedName) };
+            return path.substr(path.size() - segment.evictedNames[evictedName].nameLength);
+        }
+        return segment.getName(entry.entry);
+    }
+
+    void appendFullPath(const EntryId entry, std::string& path) const {
+        const auto& segment{ m_segments[entry.segment] };
+        path += m_topPath;
+        if (const auto evictedName{ getEvictedName(entry) }; evictedName != noParent) {
+            const auto start{ path.size() };
+            path += segment.getEvictedPath(evictedName);
+            std::replace(path.begin() + static_cast<std::ptrdiff_t>(start), path.end(), evictedPathSeparator, '\\');
+            return;
+        }
+
+        std::array<std::uint32_t, maxDepth> chain{};
+        const auto chainLength{ segment.collectChain(entry.entry, chain) };
+        for (std::size_t i{ chainLength }; i-- > 0;) {
+            path += segment.getName(chain[i]);
+            if (i) {
+                path += '\\';
+            }
+        }
+    }
+
+    // Names of the nodes from the root down to the entry,
+    // meant for DirectoryNavigator::selectPath
+    std::size_t getPathNames(const EntryId entry, const std::span<std::string_view, maxDepth> names) const {
+        const auto& segment{ m_segments[entry.segment] };
+        if (const auto evictedName{ getEvictedName(entry) }; evictedName != noParent)
+            return segment.getEvictedPathNames(evictedName, names);
+
+        std::array<std::uint32_t, maxDepth> chain{};
+        const auto chainLength{ segment.collectChain(entry.entry, chain) };
+        for (std::size_t i{}; i < chainLength; ++i) {
+            names[i] = segment.getName(chain[chainLength - 1 - i]);
+        }
+        return chainLength;
+    }
+
+    std::span<const Result> search(const std::string_view query, const std::size_t maxResults) {
+        m_results.clear();
+        m_maxResults = maxResults;
+        if (!maxResults)
+            return {};
+
+        m_foldedQuery.resize(query.size());
+        search::foldCase(query, m_foldedQuery.data());
+
+        std::array<std::string_view, maxTokens> tokens{};
+        std::size_t tokenCount{};
+        std::string_view remaining{ m_foldedQuery };
+        while (!remaining.empty() && tokenCount < maxTokens) {
+            const auto separator{ remaining.find_first_of(" \\/") };
+            const auto token{ remaining.substr(0, separator) };
+            if (!token.empty()) {
+                tokens[tokenCount++] = token;
+            }
+            if (separator == std::string_view::npos)
+                break;
+
+            remaining.remove_prefix(separator + 1);
+        }
+        if (!tokenCount)
+            return {};
+
+        const auto lastToken{ tokens[tokenCount - 1] };
+        const std::span otherTokens{ tokens.data(), tokenCount - 1 };
+        m_otherTokenBytes = 0;
+        for (const auto token : otherTokens) {
+            m_otherTokenBytes |= getByteMask(token);
+        }
+
+        // Every path starts with the top path, its bytes are never missing
+        m_otherTokenBytes &= ~getByteMask(m_foldedTopPath);
+        m_topState = {};
+        std::string_view topPath{ m_foldedTopPath };
+        while (!topPath.empty()) {
+            const auto separator{ std::min(topPath.find('\\'), topPath.size()) };
+            advancePathState(m_topState, m_topState, topPath.substr(0, separator), otherTokens);
+            topPath.remove_prefix(std::min(separator + 1, topPath.size()));
+        }
+        if (++m_generation == 0) {
+            for (auto& segment : m_segments) {
+                for (auto& state : segment.pathStates) {
+                    state.generation = 0;
+                }
+            }
+            m_generation = 1;
+        }
+
+        // Later roots only add what beats the results of earlier ones
+        for (std::uint32_t segment{}; segment < m_segments.size(); ++segment) {
+            searchSegment(segment, lastToken, otherTokens);
+            searchEvictedNames(segment, lastToken, otherTokens);
+        }
+
+        std::sort_heap(m_results.begin(), m_results.end(), isBetterResult);
+        return m_results;
+    }
+
+private:
+    static constexpr std::uint32_t noParent{ std::numeric_limits<std::uint32_t>::max() };
+    static constexpr std::size_t maxTokens{ 8 };
+    static constexpr std::size_t maxTrigrams{ 32 };
+    static constexpr std::size_t maxNameLength{ std::numeric_limits<std::uint16_t>::max() };
+    static constexpr std::uint32_t bucketBits{ 16 };
+
+    static constexpr std::uint32_t trigramBucketCount{ 1u << bucketBits };
+    static constexpr std::uint32_t byteBucketCount{ 256 };
+    static constexpr std::uint32_t bigramBucketCount{ 256 * 256 };
+    static constexpr std::uint32_t prefixBucketCount{ byteBucketCount + bigramBucketCount + trigramBucketCount };
+
+    // Where the last token matches the name, the other tokens add to it
+    static constexpr int prefixScore{ 300 };
+    static constexpr int wordStartScore{ 250 };
+    static constexpr int substringScore{ 200 };
+    static constexpr int subsequenceScore{ 100 };
+    static constexpr int pathSubstringScore{ 40 };
+    static constexpr int pathSubsequenceScore{ 10 };
+
+    // Children of an entry are next to each other and sorted by name
+    struct Entry {
+        std::uint32_t parent{};
+        std::uint32_t parentSlot{};
+        std::uint32_t firstChild{};
+        std::uint32_t childCount{};
+        std::uint32_t nameOffset{};
+        std::uint16_t nameLength{};
+        std::uint16_t depth{};
+    };
+
+    // Ranks of the entries with something in common, in ascending order.
+    // Only buckets some name of the segment is in are stored, in ascending order.
+    struct Postings {
+        std::vector<std::uint32_t> buckets{};
+        std::vector<std::uint32_t> offsets{};
+        std::vector<std::uint32_t> ranks{};
+
+        std::span<const std::uint32_t> get(const std::uint32_t bucket) const {
+            const auto found{ std::lower_bound(buckets.begin(), buckets.end(), bucket) };
+            if (found == buckets.end() || *found != bucket)
+                return {};
+
+            const auto i{ static_cast<std::size_t>(found - buckets.begin()) };
+            return std::span{ ranks }.subspan(offsets[i], offsets[i + 1] - offsets[i]);
+        }
+
+        std::size_t getMemoryUsage() const {
+            return (buckets.capacity() + offsets.capacity() + ranks.capacity()) * sizeof(std::uint32_t);
+        }
+    };
+
+    // A count and the last rank added for every bucket, shared by the segments of a build.
+    // Only the buckets used are reset, so small segments don't pay for all of them.
+    struct PostingsScratch {
+        std::vector<std::uint32_t> counts{ std::vector<std::uint32_t>(prefixBucketCount) };
+        std::vector<std::uint32_t> lastSeen{ std::vector<std::uint32_t>(prefixBucketCount, noParent) };
+    };
+
+    // How the other tokens match the path from the root down to a node with children,
+    // kept per search so nodes under the same parent don't walk the path again
+    struct PathState {
+        std::uint32_t generation{};
+        std::uint8_t substrings{};
+        std::array<std::uint32_t, maxTokens - 1> consumed{};
+    };
+
+    // A name under an evicted level, its path runs from the root.
+    // The bytes of both are checked first, like hasOtherTokenBytes does.
+    struct EvictedName {
+        std::uint64_t nameBytes{};
+        std::uint64_t pathBytes{};
+        std::uint32_t pathOffset{};
+        std::uint32_t pathLength{};
+        std::uint16_t nameLength{};
+        std::uint16_t depth{};
+    };
+
+    // Between the names of evicted paths, names never have it
+    static constexpr char evictedPathSeparator{ '/' };
+
+    // Everything indexed of a single root, which is entry 0 at depth 0.
+    // Entries past the last one are evicted names, which have no postings.
+    struct Segment {
+        std::string rootName{};
+        std::vector<Entry> entries{};
+        std::string names{};
+        std::string foldedNames{};
+        std::vector<std::uint32_t> rankedEntries{};
+        std::vector<std::uint64_t> pathBytes{};
+
+        Postings prefixPostings{};
+        Postings wordPostings{};
+        Postings bytePostings{};
+        Postings bigramPostings{};
+        Postings trigramPostings{};
+
+        // Names under levels evicted since an earlier build, no longer in the tree
+        std::string evictedPaths{};
+        std::string foldedEvictedPaths{};
+        std::vector<EvictedName> evictedNames{};
+
+        // Scratch of searches
+        std::vector<std::uint8_t> hits{};
+        std::vector<PathState> pathStates{};
+
+        std::string_view getName(const std::uint32_t entry) const {
+            const auto& data{ entries[entry] };
+            return std::string_view{ names }.substr(data.nameOffset, data.nameLength);
+        }
+
+        std::string_view getFoldedName(const std::uint32_t entry) const {
+            const auto& data{ entries[entry] };
+            return std::string_view{ foldedNames }.substr(data.nameOffset, data.nameLength);
+        }
+
+        std::string_view getEvictedPath(const std::uint32_t evictedName) const {
+            const auto& data{ evictedNames[evictedName] };
+            return std::string_view{ evictedPaths }.substr(data.pathOffset, data.pathLength);
+        }
+
+        std::string_view getFoldedEvictedPath(const std::uint32_t evictedName) const {
+            const auto& data{ evictedNames[evictedName] };
+            return std::string_view{ foldedEvictedPaths }.substr(data.pathOffset, data.pathLength);
+        }
+
+        // Names from the root down, like getPathNames
+        std::size_t getEvictedPathNames(const std::uint32_t evictedName, const std::span<std::string_view, maxDepth> names) const {
+            auto path{ getEvictedPath(evictedName) };
+            std::size_t depth{};
+            while (depth < maxDepth) {
+                const auto separator{ path.find(evictedPathSeparator) };
+                names[depth++] = path.substr(0, separator);
+                if (separator == std::string_view::npos)
+                    break;
+
+                path.remove_prefix(separator + 1);
+            }
+            return depth;
+        }
+
+        std::size_t getEvictedNameBytes() const {
+            return evictedPaths.size() + foldedEvictedPaths.size() + evictedNames.size() * sizeof(EvictedName);
+        }
+
+        std::size_t collectChain(std::uint32_t entry, std::array<std::uint32_t, maxDepth>& chain) const {
+            std::size_t length{};
+            while (entry != noParent && length < maxDepth) {
+                chain[length++] = entry;
+                entry = entries[entry].parent;
+            }
+            return length;
+        }
+
+        std::size_t getMemoryUsage() const {
+            std::size_t postings{};
+            for (const auto* list : { &prefixPostings, &wordPostings, &bytePostings, &bigramPostings, &trigramPostings }) {
+                postings += list->getMemoryUsage();
+            }
+            return rootName.capacity()
+                + entries.capacity() * sizeof(Entry)
+                + names.capacity()
+                + foldedNames.capacity()
+                + rankedEntries.capacity() * sizeof(std::uint32_t)
+                + pathBytes.capacity() * sizeof(std::uint64_t)
+                + postings
+                + getEvictedNameBytes()
+                + hits.capacity()
+                + pathStates.capacity() * sizeof(PathState);
+        }
+    };
+
+    static bool isWordSeparator(const char character) noexcept {
+        return character == '-' || character == '_' || character == ' ' || character == '.' || character == '\\';
+    }
+
+    // Which bytes text has, letters and digits each get a bit of their own
+    static std::uint64_t getByteMask(const std::string_view text) noexcept {
+        std::uint64_t mask{};
+        for (const auto character : text) {
+            const auto byte{ static_cast<unsigned char>(character) };
+            const auto bit{ byte >= 'a' && byte <= 'z' ? byte - 'a'
+                : byte >= '0' && byte <= '9' ? 26 + byte - '0'
+                : 36 + byte % 28
+            };
+            mask |= std::uint64_t{ 1 } << bit;
+        }
+        return mask;
+    }
+
+    // Index into the evicted names of the segment, noParent for an entry in the tree
+    std::uint32_t getEvictedName(const EntryId entry) const noexcept {
+        const auto entryCount{ static_cast<std::uint32_t>(m_segments[entry.segment].entries.size()) };
+        return entry.entry < entryCount ? noParent : entry.entry - entryCount;
+    }
+
+    // The other tokens can only match a path that has all their bytes
+    bool hasOtherTokenBytes(const Segment& segment, const std::uint32_t rank) const noexcept {
+        return (segment.pathBytes[rank] & m_otherTokenBytes) == m_otherTokenBytes;
+    }
+
+    // One to three bytes at the start of a name or a word in it
+    static std::uint32_t getPrefixBucket(const std::string_view prefix) noexcept {
+        switch (prefix.size()) {
+        case 1:
+            return static_cast<unsigned char>(prefix.front());
+        case 2:
+            return byteBucketCount + getBigramBucket(prefix.data());
+        default:
+            return byteBucketCount + bigramBucketCount + hashTrigram(prefix.data());
+        }
+    }
+
+    static std::uint32_t getBigramBucket(const char* const bigram) noexcept {
+        return static_cast<unsigned char>(bigram[0]) << 8 | static_cast<unsigned char>(bigram[1]);
+    }
+
+    static std::uint32_t hashTrigram(const char* const trigram) noexcept {
+        std::uint32_t hash{ 2166136261u };
+        for (std::size_t i{}; i < 3; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(trigram[i])) * 16777619u;
+        }
+        return (hash ^ (hash >> bucketBits)) & ((1u << bucketBits) - 1);
+    }
+
+    std::vector<Segment>::iterator lowerBound(const std::string_view rootName) {
+        return std::lower_bound(m_segments.begin(), m_segments.end(), rootName, [](const Segment& segment, const std::string_view name) {
+            return segment.rootName < name;
+        });
+    }
+
+    std::vector<Segment>::iterator findSegment(const std::string_view rootName) {
+        const auto segment{ lowerBound(rootName) };
+        return segment != m_segments.end() && segment->rootName == rootName ? segment : m_segments.end();
+    }
+
+    // Names of levels evicted since previous was built are kept apart from the postings,
+    // up to evictedNameLimit bytes together with those still evicted from before
+    static Segment buildSegment(
+        const DirectoryNode& root,
+        const Segment* const previous,
+        const std::size_t evictedNameLimit,
+        PostingsScratch& scratch
+    ) {
+        Segment segment{ .rootName{ std::string{ root.getName() } } };
+        if (previous) {
+            segment.entries.reserve(previous->entries.size());
+            segment.names.reserve(previous->names.size());
+        }
+
+        struct Frame {
+            const DirectoryNode* node{};
+            std::uint32_t entry{};
+            std::uint32_t slot{};
+        };
+        std::vector<Frame> stack{};
+        std::uint32_t slotCount{};
+        const auto addEntry{ [&](
+            const std::string_view name,
+            const DirectoryNode& node,
+            const std::uint32_t parentEntry,
+            const std::uint32_t parentSlot
+        ) {
+            const auto entry{ static_cast<std::uint32_t>(segment.entries.size()) };
+            segment.entries.push_back({
+                .parent{ parentEntry },
+                .parentSlot{ parentSlot },
+                .nameOffset{ static_cast<std::uint32_t>(segment.names.size()) },
+                .nameLength{ static_cast<std::uint16_t>(std::min<std::size_t>(name.size(), maxNameLength)) },
+                .depth{ parentEntry == noParent
+                    ? std::uint16_t{ 0 }
+                    : static_cast<std::uint16_t>(segment.entries[parentEntry].depth + 1)
+                },
+            });
+            segment.names.append(name, 0, maxNameLength);
+
+            if (node.getChildCount()) {
+                stack.push_back({ &node, entry, slotCount++ });
+            }
+        } };
+
+        addEntry(root.getName(), root, noParent, noParent);
+        while (!stack.empty()) {
+            const auto [node, parentEntry, parentSlot] { stack.back() };
+            stack.pop_back();
+
+            const auto firstChild{ static_cast<std::uint32_t>(segment.entries.size()) };
+            for (const auto& [name, child] : node->getChildren()) {
+                addEntry(name, child, parentEntry, parentSlot);
+            }
+            segment.entries[parentEntry].firstChild = firstChild;
+            segment.entries[parentEntry].childCount = static_cast<std::uint32_t>(segment.entries.size()) - firstChild;
+        }
+
+        if (previous && evictedNameLimit) {
+            collectEvictedNames(segment, root, *previous, evictedNameLimit);
+        }
+
+        segment.foldedNames.resize(segment.names.size());
+        search::foldCase(segment.names, segment.foldedNames.data());
+
+        rankEntries(segment);
+
+        // Parents always come before their children
+        segment.pathBytes.resize(segment.entries.size());
+        std::vector<std::uint64_t> pathBytes(segment.entries.size());
+        for (std::uint32_t entry{}; entry < segment.entries.size(); ++entry) {
+            const auto parent{ segment.entries[entry].parent };
+            pathBytes[entry] = getByteMask(segment.getFoldedName(entry)) | (parent == noParent ? 0 : pathBytes[parent]);
+        }
+        for (std::uint32_t rank{}; rank < segment.rankedEntries.size(); ++rank) {
+            segment.pathBytes[rank] = pathBytes[segment.rankedEntries[rank]];
+        }
+
+        buildPostings(segment, segment.prefixPostings, scratch, [](const std::string_view name, const auto& add) {
+            for (std::size_t length{ 1 }; length <= std::min<std::size_t>(name.size(), 3); ++length) {
+                add(getPrefixBucket(name.substr(0, length)));
+            }
+        });
+        buildPostings(segment, segment.wordPostings, scratch, [](const std::string_view name, const auto& add) {
+            for (std::size_t i{ 1 }; i < name.size(); ++i) {
+                if (isWordSeparator(name[i - 1])) {
+                    for (std::size_t length{ 1 }; length <= std::min<std::size_t>(name.size() - i, 3); ++length) {
+                        add(getPrefixBucket(name.substr(i, length)));
+                    }
+                }
+            }
+        });
+        buildPostings(segment, segment.bytePostings, scratch, [](const std::string_view name, const auto& add) {
+            for (const auto byte : name) {
+                add(static_cast<unsigned char>(byte));
+            }
+        });
+        buildPostings(segment, segment.bigramPostings, scratch, [](const std::string_view name, const auto& add) {
+            for (std::size_t i{}; i + 2 <= name.size(); ++i) {
+                add(getBigramBucket(name.data() + i));
+            }
+        });
+        buildPostings(segment, segment.trigramPostings, scratch, [](const std::string_view name, const auto& add) {
+            for (std::size_t i{}; i + 3 <= name.size(); ++i) {
+                add(hashTrigram(name.data() + i));
+            }
+        });
+
+        segment.hits.assign(segment.entries.size(), 0);
+        segment.pathStates.assign(slotCount, {});
+        return segment;
+    }
+
+    // Shallower names come first, at the same depth those evicted earlier.
+    // Once limit is reached the rest is left out.
+    static void collectEvictedNames(
+        Segment& segment,
+        const DirectoryNode& root,
+        const Segment& previous,
+        const std::size_t limit
+    ) {
+        // An entry of previous, or one of its evicted names
+        struct Candidate {
+            std::uint16_t depth{};
+            bool isEvictedName{};
+            std::uint32_t index{};
+        };
+        std::vector<Candidate> candidates{};
+
+        std::array<std::string_view, maxDepth> names{};
+        for (std::uint32_t i{}; i < previous.evictedNames.size(); ++i) {
+            const auto depth{ previous.getEvictedPathNames(i, names) };
+            if (isUnderEvictedLevel(root, { names.data(), depth })) {
+                candidates.push_back({ previous.evictedNames[i].depth, true, i });
+            }
+        }
+
+        // Walks the previous entries along the tree, those missing under an evicted node were evicted
+        std::vector<std::pair<std::uint32_t, const DirectoryNode*>> levels{ { 0, &root } };
+        std::vector<std::uint32_t> evicted{};
+        while (!levels.empty()) {
+            const auto [entry, node] { levels.back() };
+            levels.pop_back();
+
+            const auto& data{ previous.entries[entry] };
+            for (auto child{ data.firstChild }; child < data.firstChild + data.childCount; ++child) {
+                const auto childNode{ node->findChild(previous.getName(child)) };
+                if (childNode == node->getChildren().end()) {
+                    if (node->isEvicted()) {
+                        evicted.push_back(child);
+                    }
+                } else if (previous.entries[child].childCount) {
+                    levels.emplace_back(child, &childNode->second);
+                }
+            }
+        }
+        while (!evicted.empty()) {
+            const auto entry{ evicted.back() };
+            evicted.pop_back();
+
+            const auto& data{ previous.entries[entry] };
+            candidates.push_back({ data.depth, false, entry });
+            for (auto child{ data.firstChild }; child < data.firstChild + data.childCount; ++child) {
+                evicted.push_back(child);
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+            return lhs.depth < rhs.depth;
+        });
+
+        std::size_t size{};
+        std::array<std::uint32_t, maxDepth> chain{};
+        for (const auto& candidate : candidates) {
+            std::size_t depth{};
+            if (candidate.isEvictedName) {
+                depth = previous.getEvictedPathNames(candidate.index, names);
+            } else {
+                depth = previous.collectChain(candidate.index, chain);
+                for (std::size_t i{}; i < depth; ++i) {
+                    names[i] = previous.getName(chain[depth - 1 - i]);
+                }
+            }
+
+            std::size_t length{ depth - 1 };
+            for (std::size_t i{}; i < depth; ++i) {
+                length += names[i].size();
+            }
+            size += 2 * length + sizeof(EvictedName);
+            if (size > limit)
+                break;
+
+            const auto offset{ segment.evictedPaths.size() };
+            for (std::size_t i{}; i < depth; ++i) {
+                if (i) {
+                    segment.evictedPaths += evictedPathSeparator;
+                }
+                segment.evictedPaths += names[i];
+            }
+            segment.evictedNames.push_back({
+                .pathOffset{ static_cast<std::uint32_t>(offset) },
+                .pathLength{ static_cast<std::uint32_t>(length) },
+                .nameLength{ static_cast<std::uint16_t>(names[depth - 1].size()) },
+                .depth{ static_cast<std::uint16_t>(depth - 1) },
+            });
+        }
+
+        segment.evictedPaths.shrink_to_fit();
+        segment.evictedNames.shrink_to_fit();
+        segment.foldedEvictedPaths.resize(segment.evictedPaths.size());
+        search::foldCase(segment.evictedPaths, segment.foldedEvictedPaths.data());
+        for (std::uint32_t i{}; i < segment.evictedNames.size(); ++i) {
+            const auto path{ segment.getFoldedEvictedPath(i) };
+            auto& data{ segment.evictedNames[i] };
+            data.nameBytes = getByteMask(path.substr(path.size() - data.nameLength));
+            data.pathBytes = getByteMask(path);
+        }
+    }
+
+    // Whether the path leads through a node that was evicted and doesn't have the rest anymore
+    static bool isUnderEvictedLevel(const DirectoryNode& root, const std::span<const std::string_view> names) {
+        const DirectoryNode* node{ &root };
+        for (std::size_t i{ 1 }; i < names.size(); ++i) {
+            const auto child{ node->findChild(names[i]) };
+            if (child == node->getChildren().end())
+                return node->isEvicted();
+
+            node = &child->second;
+        }
+        return false;
+    }
+
+    // Deeper nodes and longer names score lower, both cost the same per two
+    // units of this, entries are ranked by it with a counting sort
+    static std::uint32_t getRankKey(const Entry& entry) noexcept {
+        return 2 * std::uint32_t{ entry.depth } + entry.nameLength;
+    }
+
+    static void rankEntries(Segment& segment) {
+        std::vector<std::uint32_t> offsets{};
+        for (const auto& entry : segment.entries) {
+            const auto key{ getRankKey(entry) };
+            if (key + 2 > offsets.size()) {
+                offsets.resize(key + 2);
+            }
+            ++offsets[key + 1];
+        }
+        for (std::size_t i{ 1 }; i < offsets.size(); ++i) {
+            offsets[i] += offsets[i - 1];
+        }
+
+        segment.rankedEntries.resize(segment.entries.size());
+        for (std::uint32_t entry{}; entry < segment.entries.size(); ++entry) {
+            segment.rankedEntries[offsets[getRankKey(segment.entries[entry])]++] = entry;
+        }
+    }
+
+    // forEachBucket calls its second argument with every bucket of a folded name,
+    // a name is added to each bucket once
+    template<typename ForEachBucket>
+    static void buildPostings(
+        const Segment& segment,
+        Postings& postings,
+        PostingsScratch& scratch,
+        const ForEachBucket& forEachBucket
+    ) {
+        auto& counts{ scratch.counts };
+        auto& lastSeen{ scratch.lastSeen };
+        const auto forEachPosting{ [&](const auto& callback) {
+            for (std::uint32_t rank{}; rank < segment.rankedEntries.size(); ++rank) {
+                forEachBucket(segment.getFoldedName(segment.rankedEntries[rank]), [&](const std::uint32_t bucket) {
+                    if (lastSeen[bucket] == rank)
+                        return;
+
+                    lastSeen[bucket] = rank;
+                    callback(bucket, rank);
+                });
+            }
+            for (const auto bucket : postings.buckets) {
+                lastSeen[bucket] = noParent;
+            }
+        } };
+
+        postings.buckets.clear();
+        forEachPosting([&](const std::uint32_t bucket, std::uint32_t) {
+            if (!counts[bucket]++) {
+                postings.buckets.push_back(bucket);
+            }
+        });
+        std::sort(postings.buckets.begin(), postings.buckets.end());
+        postings.buckets.shrink_to_fit();
+
+        // Counts become the cursors of their buckets
+        postings.offsets.resize(postings.buckets.size() + 1);
+        postings.offsets[0] = 0;
+        for (std::size_t i{}; i < postings.buckets.size(); ++i) {
+            const auto bucket{ postings.buckets[i] };
+            postings.offsets[i + 1] = postings.offsets[i] + counts[bucket];
+            counts[bucket] = postings.offsets[i];
+        }
+
+        postings.ranks.resize(postings.offsets.back());
+        forEachPosting([&](const std::uint32_t bucket, const std::uint32_t rank) {
+            postings.ranks[counts[bucket]++] = rank;
+        });
+        for (const auto bucket : postings.buckets) {
+            counts[bucket] = 0;
+        }
+    }
+
+    void searchSegment(
+        const std::uint32_t segmentIndex,
+        const std::string_view lastToken,
+        const std::span<const std::string_view> otherTokens
+    ) {
+        auto& segment{ m_segments[segmentIndex] };
+
+        // Names starting with the token score highest, then names with a word starting with it,
+        // each pass only verifies the names that get its score
+        const auto prefixBucket{ getPrefixBucket(lastToken.substr(0, 3)) };
+        verifyMatches(segmentIndex, segment.prefixPostings.get(prefixBucket), prefixScore, lastToken, otherTokens);
+        verifyMatches(segmentIndex, segment.wordPostings.get(prefixBucket), wordStartScore, lastToken, otherTokens);
+
+        // Too short for trigrams, only plain substrings are accepted then
+        if (lastToken.size() == 1) {
+            verifyMatches(segmentIndex, segment.bytePostings.get(static_cast<unsigned char>(lastToken[0])), substringScore, lastToken, otherTokens);
+            return;
+        }
+        if (lastToken.size() == 2) {
+            verifyMatches(segmentIndex, segment.bigramPostings.get(getBigramBucket(lastToken.data())), substringScore, lastToken, otherTokens);
+            return;
+        }
+
+        std::array<std::uint32_t, maxTrigrams> buckets{};
+        std::size_t bucketCount{};
+        for (std::size_t i{}; i + 3 <= lastToken.size() && bucketCount < maxTrigrams; ++i) {
+            const auto bucket{ hashTrigram(lastToken.data() + i) };
+            if (std::find(buckets.begin(), buckets.begin() + bucketCount, bucket) == buckets.begin() + bucketCount) {
+                buckets[bucketCount++] = bucket;
+            }
+        }
+
+        const std::span bucketSpan{ buckets.data(), bucketCount };
+        auto shortest{ segment.trigramPostings.get(buckets[0]) };
+        for (const auto bucket : bucketSpan) {
+            const auto postings{ segment.trigramPostings.get(bucket) };
+            if (postings.size() < shortest.size()) {
+                shortest = postings;
+            }
+        }
+
+        // Exact candidates are in every list, so in the shortest one in rank order.
+        // Having all trigrams doesn't make the token a substring, those are scored like typos.
+        for (const auto rank : shortest) {
+            if (isOutOfReach(segmentIndex, rank, substringScore, lastToken, otherTokens))
+                break;
+            if (!hasOtherTokenBytes(segment, rank))
+                continue;
+
+            const auto name{ segment.getFoldedName(segment.rankedEntries[rank]) };
+            const auto nameScore{ getNameScore(name, lastToken) };
+            if (nameScore == substringScore) {
+                verify(segmentIndex, rank, nameScore, lastToken, otherTokens);
+            } else if (!nameScore && hasAllTrigrams(name, bucketSpan)) {
+                verify(segmentIndex, rank, getTypoScore(name, lastToken, bucketCount, bucketCount), lastToken, otherTokens);
+            }
+        }
+
+        // Only when exact candidates are not enough, allow roughly
+        // a third of the trigrams to be missing to tolerate typos
+        const auto threshold{ std::max<std::size_t>(1, (bucketCount * 2 + 2) / 3) };
+        if (m_results.size() < m_maxResults && threshold < bucketCount) {
+            for (const auto bucket : bucketSpan) {
+                for (const auto rank : segment.trigramPostings.get(bucket)) {
+                    if (!segment.hits[rank]++) {
+                        m_touched.push_back(rank);
+                    }
+                }
+            }
+
+            for (const auto rank : m_touched) {
+                const bool isCandidate{ segment.hits[rank] >= threshold && segment.hits[rank] < bucketCount };
+                if (isCandidate && hasOtherTokenBytes(segment, rank) && !isOutOfReach(segmentIndex, rank, subsequenceScore, lastToken, otherTokens)) {
+                    const auto name{ segment.getFoldedName(segment.rankedEntries[rank]) };
+                    verify(segmentIndex, rank, getTypoScore(name, lastToken, segment.hits[rank], bucketCount), lastToken, otherTokens);
+                }
+                segment.hits[rank] = 0;
+            }
+        }
+        m_touched.clear();
+    }
+
+    // Evicted names have no postings, there are few enough to check each like verify does
+    void searchEvictedNames(
+        const std::uint32_t segmentIndex,
+        const std::string_view lastToken,
+        const std::span<const std::string_view> otherTokens
+    ) {
+        const auto& segment{ m_segments[segmentIndex] };
+        const auto entryCount{ static_cast<std::uint32_t>(segment.entries.size()) };
+        const auto lastTokenBytes{ getByteMask(lastToken) };
+        for (std::uint32_t i{}; i < segment.evictedNames.size(); ++i) {
+            const auto& data{ segment.evictedNames[i] };
+            if ((data.nameBytes & lastTokenBytes) != lastTokenBytes || (data.pathBytes & m_otherTokenBytes) != m_otherTokenBytes)
+                continue;
+
+            const auto path{ segment.getFoldedEvictedPath(i) };
+            const auto name{ path.substr(path.size() - data.nameLength) };
+            auto score{ getNameScore(name, lastToken) };
+            if (!score) {
+                if (search::matchSubsequence(name, lastToken) != lastToken.size())
+                    continue;
+
+                score = subsequenceScore;
+            }
+
+            // The path has every name of it, the separators between them are in no token
+            bool isMatch{ true };
+            for (std::size_t token{}; token < otherTokens.size() && isMatch; ++token) {
+                if (m_topState.substrings >> token & 1 || search::find(path, otherTokens[token]) != std::string_view::npos) {
+                    score += pathSubstringScore;
+                } else if (search::matchSubsequence(path, otherTokens[token], m_topState.consumed[token]) == otherTokens[token].size()) {
+                    score += pathSubsequenceScore;
+                } else {
+                    isMatch = false;
+                }
+            }
+            if (!isMatch)
+                continue;
+
+            score -= data.depth;
+            score -= static_cast<int>((name.size() - std::min(name.size(), lastToken.size())) / 2);
+            addResult({
+                .entry{ .segment{ segmentIndex }, .entry{ entryCount + i } },
+                .score{ score },
+                .rankKey{ 2 * std::uint32_t{ data.depth } + data.nameLength },
+                .rank{ entryCount + i },
+            });
+        }
+    }
+
+    // Whether the results are full with ones better than the best result the entry,
+    // or any entry ranked after it in its segment, could get when its name matches with baseScore
+    bool isOutOfReach(
+        const std::uint32_t segmentIndex,
+        const std::uint32_t rank,
+        const int baseScore,
+        const std::string_view lastToken,
+        const std::span<const std::string_view> otherTokens
+    ) const {
+        if (m_results.size() < m_maxResults)
+            return false;
+
+        const auto& segment{ m_segments[segmentIndex] };
+        const auto key{ getRankKey(segment.entries[segment.rankedEntries[rank]]) };
+        const auto minPenalty{ key > lastToken.size() ? static_cast<int>((key - lastToken.size()) / 2) : 0 };
+        const auto maxScore{ baseScore + pathSubstringScore * static_cast<int>(otherTokens.size()) - minPenalty };
+        return !isBetterResult({
+            .entry{ .segment{ segmentIndex } },
+            .score{ maxScore },
+            .rankKey{ key },
+            .rank{ rank },
+        }, m_results.front());
+    }
+
+    // State of the path down to and including entry, which has the given slot
+    const PathState& getPathState(
+        Segment& segment,
+        const std::uint32_t entry,
+        const std::uint32_t slot,
+        const std::span<const std::string_view> tokens
+    ) {
+        if (slot == noParent)
+            return m_topState;
+
+        // Walks up to the first node already known in this search, then back down
+        m_stalePath.clear();
+        auto pathEntry{ entry };
+        auto pathSlot{ slot };
+        while (pathSlot != noParent && segment.pathStates[pathSlot].generation != m_generation) {
+            m_stalePath.push_back(pathEntry);
+            pathSlot = segment.entries[pathEntry].parentSlot;
+            pathEntry = segment.entries[pathEntry].parent;
+        }
+
+        const auto* parentState{ pathSlot == noParent ? &m_topState : &segment.pathStates[pathSlot] };
+        for (std::size_t i{ m_stalePath.size() }; i-- > 0;) {
+            const auto staleEntry{ m_stalePath[i] };
+            auto& state{ segment.pathStates[i ? segment.entries[m_stalePath[i - 1]].parentSlot : slot] };
+
+            state.generation = m_generation;
+            advancePathState(state, *parentState, segment.getFoldedName(staleEntry), tokens);
+            parentState = &state;
+        }
+        return *parentState;
+    }
+
+    // state may be parentState itself
+    static void advancePathState(
+        PathState& state,
+        const PathState& parentState,
+        const std::string_view name,
+        const std::span<const std::string_view> tokens
+    ) noexcept {
+        state.substrings = parentState.substrings;
+        for (std::size_t token{}; token < tokens.size(); ++token) {
+            if (search::find(name, tokens[token]) != std::string_view::npos) {
+                state.substrings |= static_cast<std::uint8_t>(1u << token);
+            }
+            state.consumed[token] = static_cast<std::uint32_t>(
+                search::matchSubsequence(name, tokens[token], parentState.consumed[token])
+            );
+        }
+    }
+
+    // What the last token scores against the name itself when it's a substring, 0 otherwise
+    static int getNameScore(const std::string_view name, const std::string_view token) noexcept {
+        const auto position{ search::find(name, token) };
+        if (position == std::string_view::npos)
+            return 0;
+        if (position == 0)
+            return prefixScore;
+
+        return isWordSeparator(name[position - 1]) ? wordStartScore : substringScore;
+    }
+
+    static bool hasAllTrigrams(const std::string_view name, const std::span<const std::uint32_t> buckets) noexcept {
+        return std::all_of(buckets.begin(), buckets.end(), [&](const std::uint32_t bucket) {
+            for (std::size_t i{}; i + 3 <= name.size(); ++i) {
+                if (hashTrigram(name.data() + i) == bucket)
+                    return true;
+            }
+            return false;
+        });
+    }
+
+    static int getTypoScore(
+        const std::string_view name,
+        const std::string_view token,
+        const std::size_t trigramHits,
+        const std::size_t trigramCount
+    ) noexcept {
+        if (search::matchSubsequence(name, token) == token.size())
+            return subsequenceScore;
+
+        return static_cast<int>(50 * trigramHits / trigramCount);
+    }
+
+    // Verifies the candidates whose names score exactly nameScore, until no later one can make it
+    void verifyMatches(
+        const std::uint32_t segmentIndex,
+        const std::span<const std::uint32_t> candidates,
+        const int nameScore,
+        const std::string_view lastToken,
+        const std::span<const std::string_view> otherTokens
+    ) {
+        const auto& segment{ m_segments[segmentIndex] };
+        for (const auto rank : candidates) {
+            if (isOutOfReach(segmentIndex, rank, nameScore, lastToken, otherTokens))
+                break;
+
+            if (hasOtherTokenBytes(segment, rank) && getNameScore(segment.getFoldedName(segment.rankedEntries[rank]), lastToken) == nameScore) {
+                verify(segmentIndex, rank, nameScore, lastToken, otherTokens);
+            }
+        }
+    }
+
+    // The last token has already matched the name of the node itself,
+    // the others can match anywhere along the path
+    void verify(
+        const std::uint32_t segmentIndex,
+        const std::uint32_t rank,
+        int score,
+        const std::string_view lastToken,
+        const std::span<const std::string_view> otherTokens
+    ) {
+        auto& segment{ m_segments[segmentIndex] };
+        const auto entry{ segment.rankedEntries[rank] };
+        const auto& data{ segment.entries[entry] };
+        const auto name{ segment.getFoldedName(entry) };
+        if (!otherTokens.empty()) {
+            const auto& parentState{ getPathState(segment, data.parent, data.parentSlot, otherTokens) };
+
+            for (std::size_t i{}; i < otherTokens.size(); ++i) {
+                const auto token{ otherTokens[i] };
+                if (parentState.substrings >> i & 1 || search::find(name, token) != std::string_view::npos) {
+                    score += pathSubstringScore;
+                    continue;
+                }
+                if (search::matchSubsequence(name, token, parentState.consumed[i]) != token.size())
+                    return;
+
+                score += pathSubsequenceScore;
+            }
+        }
+
+        // Prefer shallow nodes with names close to what was typed
+        score -= data.depth;
+        score -= static_cast<int>((name.size() - std::min(name.size(), lastToken.size())) / 2);
+        addResult({
+            .entry{ .segment{ segmentIndex }, .entry{ entry } },
+            .score{ score },
+            .rankKey{ getRankKey(data) },
+            .rank{ rank },
+        });
+    }
+
+    static bool isBetterResult(const Result& lhs, const Result& rhs) noexcept {
+        if (lhs.score != rhs.score)
+            return lhs.score > rhs.score;
+        if (lhs.rankKey != rhs.rankKey)
+            return lhs.rankKey < rhs.rankKey;
+        if (lhs.entry.segment != rhs.entry.segment)
+            return lhs.entry.segment < rhs.entry.segment;
+
+        return lhs.rank < rhs.rank;
+    }
+
+    // Keeps only the best m_maxResults as a heap with the worst one on top
+    void addResult(const Result result) {
+        if (m_results.size() < m_maxResults) {
+            m_results.push_back(result);
+            std::push_heap(m_results.begin(), m_results.end(), isBetterResult);
+            return;
+        }
+
+        if (!isBetterResult(result, m_results.front()))
+            return;
+
+        std::pop_heap(m_results.begin(), m_results.end(), isBetterResult);
+        m_results.back() = result;
+        std::push_heap(m_results.begin(), m_results.end(), isBetterResult);
+    }
+
+    // Sorted by root name like the children of the top node
+    std::vector<Segment> m_segments{};
+    std::size_t m_evictedNameLimit{};
+
+    // Starts every full path, a drive flattened into the top node
+    std::string m_topPath{};
+    std::string m_foldedTopPath{};
+
+    // Scratch buffers reused between searches
+    std::string m_foldedQuery{};
+    std::vector<std::uint32_t> m_touched{};
+    std::vector<Result> m_results{};
+    std::size_t m_maxResults{};
+    std::vector<std::uint32_t> m_stalePath{};
+    PathState m_topState{};
+    std::uint32_t m_generation{};
+    std::uint64_t m_otherTokenBytes{};
+};
@@ -1,6 +1,10 @@
 #include "directory-select-window.h"
+#include "utf8.h"
 
 #include <chrono>
+#include <fstream>
+#include <optional>
+#include <string_view>
 
 #ifdef _DEBUG
 #include <print>
@@ -15,141 +19,16 @@ int DirectorySelectWindow::runMessageLoop() const {
     return static_cast<int>(message.wParam);
 }
 
-void DirectorySelectWindow::drawDirectories() const {
-    d2d.renderTarget->BeginDraw();
-    d2d.renderTarget->Clear(m_backgroundTintColor);
-
-    ::D2D1_RECT_F drawableArea{ m_window.drawableArea };
-    const auto textHeight{ m_navigator->getCurrentNode()->getLongestChildSize().height };
-    for (const auto& [name, node] : m_navigator->getCurrentNode()->getChildren()) {
-        ::ID2D1SolidColorBrush* brush{};
-        if (m_window.hasFocus && m_navigator->getSelectedChild()->getName() == name) {
-            brush = node.getChildCount() ? d2d.yellowBrush.Get() : d2d.orangeBrush.Get();
-        } else {
-            brush = d2d.whiteBrush.Get();
-        }
-
-        // TODO: Might want to switch to DrawTextLayout,
-        // because this creates a text layout every time it's called.
-        // We could reuse them if the user presses arrow down or up
-        // Also consider just drawing the whole text with one draw call
-        // by caching it in the parent node.
-        d2d.renderTarget->DrawText(
-            name.c_str(),
-            static_cast<::UINT32>(name.size()),
-            d2d.textFormat.Get(),
-            drawableArea,
-            brush
-        );
-        drawableArea.top += textHeight;
-    }
-
-    d2d.renderTarget->EndDraw();
-}
-
-void DirectorySelectWindow::cacheNodeSize(DirectoryNode* const node) const {
-    wrl::ComPtr<::IDWriteTextLayout> textLayout{};
-    d2d.writeFactory->CreateTextLayout(
-        node->getLongestChildName().data(),
-        static_cast<::UINT32>(node->getLongestChildName().size()),
-        d2d.textFormat.Get(),
-        0.f,
-        0.f,
-        &textLayout
-    );
-
-    ::DWRITE_TEXT_METRICS textMetrics{};
-    textLayout->GetMetrics(&textMetrics);
-    node->setLongestChildSize(textMetrics.width, std::ceil(textMetrics.height + m_styleConfig.gaps));
-}
-
-void DirectorySelectWindow::fitToContent() {
-    const auto& currentNode{ m_navigator->getCurrentNode() };
-
-    if (!currentNode->getLongestChildSize().width) {
-        cacheNodeSize(currentNode);
-    }
-
-    const auto longestChildSize{ currentNode->getLongestChildSize() };
-
-    m_window.width = static_cast<int>(
-        longestChildSize.width + m_styleConfig.padding.horizontal * 2
-    );
-
-    m_window.height = static_cast<int>(
-        longestChildSize.height * static_cast<float>(currentNode->getChildCount())
-        + m_styleConfig.padding.vertical * 2
-        - m_styleConfig.gaps
-    );
-
-    m_window.drawableArea = D2D1::RectF(
-        m_styleConfig.padding.horizontal,
-        m_styleConfig.padding.vertical,
-        static_cast<float>(m_window.width) - m_styleConfig.padding.horizontal,
-        static_cast<float>(m_window.height) - m_styleConfig.padding.vertical
-    );
-
-    // Prevents 1 frame flicking of text when the window is resized
-    d2d.renderTarget->BeginDraw();
-    d2d.renderTarget->Clear(m_backgroundTintColor);
-    d2d.renderTarget->EndDraw();
-
+void DirectorySelectWindow::resizeWindow(const int width, const int height) {
     ::SetWindowPos(
         m_window.handle,
         HWND_TOPMOST,
-        (::GetSystemMetrics(SM_CXSCREEN) - m_window.width) / 2,
-        (::GetSystemMetrics(SM_CYSCREEN) - m_window.height) / 2,
-        m_window.width,
-        m_window.height,
+        (::GetSystemMetrics(SM_CXSCREEN) - width) / 2,
+        (::GetSystemMetrics(SM_CYSCREEN) - height) / 2,
+        width,
+        height,
         SWP_SHOWWINDOW | SWP_NOREDRAW
     );
-
-    d2d.renderTarget->Resize(D2D1::SizeU(
-        static_cast<unsigned int>(m_window.width),
-        static_cast<unsigned int>(m_window.height)
-    ));
-}
-
-void DirectorySelectWindow::setupDirect2D() {
-    ::D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, d2d.factory.GetAddressOf());
-
-    d2d.factory->CreateHwndRenderTarget(
-        D2D1::RenderTargetProperties(
-            D2D1_RENDER_TARGET_TYPE_DEFAULT,
-            D2D1::PixelFormat(DXGI_FORMAT_UNKNOWN, D2D1_ALPHA_MODE_PREMULTIPLIED)
-        ),
-        D2D1::HwndRenderTargetProperties(m_window.handle),
-        &d2d.renderTarget
-    );
-    d2d.renderTarget->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
-
-    d2d.renderTarget->CreateSolidColorBrush(
-        D2D1::ColorF(D2D1::ColorF::White), &d2d.whiteBrush
-    );
-    d2d.renderTarget->CreateSolidColorBrush(
-        D2D1::ColorF(D2D1::ColorF::Yellow), &d2d.yellowBrush
-    );
-    d2d.renderTarget->CreateSolidColorBrush(
-        D2D1::ColorF(1.f, .5f, 0.f, 1.f), &d2d.orangeBrush
-    );
-
-    ::DWriteCreateFactory(
-        DWRITE_FACTORY_TYPE_SHARED,
-        __uuidof(::IDWriteFactory),
-        reinterpret_cast<::IUnknown**>(d2d.writeFactory.GetAddressOf())
-    );
-
-    d2d.writeFactory->CreateTextFormat(
-        L"Arial",
-        NULL,
-        DWRITE_FONT_WEIGHT_NORMAL,
-        DWRITE_FONT_STYLE_NORMAL,
-        DWRITE_FONT_STRETCH_NORMAL,
-        m_styleConfig.fontSize,
-        L"pl-PL",
-        &d2d.textFormat
-    );
-    d2d.textFormat->SetWordWrapping(DWRITE_WORD_WRAPPING_NO_WRAP);
 }
 
 void DirectorySelectWindow::setupWindow() {
@@ -188,28 +67,78 @@ void DirectorySelectWindow::setupWindow() {
 }
 
 static void openExplorerWindow(
-    const std::wstring_view path,
+    const std::string_view path,
     const ::HWND windowToClose
 ) {
+    const auto widePath{ utf8::toWide(path) };
     if (!windowToClose) {
         ::ShellExecute(
-            NULL, TEXT("explore"), path.data(),
+            NULL, TEXT("explore"), widePath.c_str(),
             NULL, NULL, SW_SHOWNOACTIVATE
         );
         return;
     }
     
     ::ShellExecute(
-        NULL, TEXT("explore"), path.data(),
+        NULL, TEXT("explore"), widePath.c_str(),
         NULL, NULL, SW_SHOWDEFAULT
     );
     ::PostMessage(windowToClose, WM_QUIT, 0, 0);
 }
 
+void DirectorySelectWindow::openExplorer(const std::string_view path, const bool keepOpen) {
+    openExplorerWindow(path, keepOpen ? 0 : m_window.handle);
+}
+
+void DirectorySelectWindow::writeReport() {
+    std::ofstream reportFile{ reportPath };
+    writeReport(reportFile);
+}
+
+void DirectorySelectWindow::close() {
+    ::PostMessage(m_window.handle, WM_QUIT, 0, 0);
+}
+
+static std::optional<DirectoryView::KeyPress> toViewKeyPress(const ::WPARAM keyCode) {
+    using Key = DirectoryView::Key;
+
+    if (keyCode >= 'A' && keyCode <= 'Z')
+        return DirectoryView::KeyPress{
+            .key{ Key::Letter },
+            .letter{ static_cast<char>(keyCode - 'A' + 'a') },
+        };
+
+    switch (keyCode) {
+    case VK_UP:
+        return DirectoryView::KeyPress{ .key{ Key::Up } };
+    case VK_DOWN:
+        return DirectoryView::KeyPress{ .key{ Key::Down } };
+    case VK_LEFT:
+        return DirectoryView::KeyPress{ .key{ Key::Left } };
+    case VK_RIGHT:
+        return DirectoryView::KeyPress{ .key{ Key::Right } };
+    case VK_RETURN:
+        return DirectoryView::KeyPress{ .key{ Key::Return } };
+    case VK_SPACE:
+        return DirectoryView::KeyPress{ .key{ Key::Space } };
+    case VK_TAB:
+        return DirectoryView::KeyPress{ .key{ Key::Tab } };
+    case VK_ESCAPE:
+        return DirectoryView::KeyPress{ .key{ Key::Escape } };
+    case VK_BACK:
+        return DirectoryView::KeyPress{ .key{ Key::Backspace } };
+    case VK_LSHIFT:
+        return DirectoryView::KeyPress{ .key{ Key::LeftShift } };
+    default:
+        return std::nullopt;
+    }
+}
+
 void DirectorySelectWindow::handleKeyPress(
     const ::WPARAM keyCode,
     const ::LPARAM lParam,
-    const bool isLeftShiftDown
+    const bool isLeftShiftDown,
+    const InputLatencyRecorder::Clock::time_point inputTime
 ) {
     static std::chrono::high_resolution_clock::time_point lastRepeatedChar{};
     if (HIWORD(lParam) & KF_REPEAT) {
@@ -220,59 +149,82 @@ void DirectorySelectWindow::handleKeyPress(
         lastRepeatedChar = std::chrono::high_resolution_clock::now();
     }
 
-    switch (keyCode) {
-    case VK_LSHIFT:
-    case VK_LEFT:
-    case 'A':
-    case 'a':
-        if (m_navigator->enterParent()) {
-            fitToContent();
-        }
-        drawDirectories();
-        break;
-    case VK_RIGHT:
-    case 'D':
-    case 'd':
-        if (m_navigator->enterSelected()) {
-            fitToContent();
+    auto keyPress{ toViewKeyPress(keyCode) };
+    if (!keyPress)
+        return;
+
+    keyPress->isLeftShiftDown = isLeftShiftDown;
+    if (m_keyRecording) {
+        m_keyRecording->recordKeyPress(*keyPress);
+    }
+    m_view->handleKeyPress(*keyPress, inputTime);
+}
+
+void DirectorySelectWindow::handleCharInput(const wchar_t unit) {
+    if (unit >= 0xD800 && unit < 0xDC00) {
+        m_highSurrogate = unit;
+        return;
+    }
+
+    auto character{ static_cast<char32_t>(unit) };
+    if (unit >= 0xDC00 && unit < 0xE000) {
+        if (!m_highSurrogate)
+            return;
+
+        character = 0x10000
+            + (static_cast<char32_t>(m_highSurrogate - 0xD800) << 10)
+            + static_cast<char32_t>(unit - 0xDC00);
+    }
+    m_highSurrogate = 0;
+
+    if (m_keyRecording) {
+        m_keyRecording->recordCharInput(character);
+    }
+    m_view->handleCharInput(character);
+}
+
+bool DirectorySelectWindow::answerQuery(const ::HWND sender, const ::COPYDATASTRUCT& query) {
+    if (query.dwData != resolveQuery && query.dwData != childrenQuery)
+        return false;
+
+    m_queryIndex->update(*m_navigator->getRoot(), m_navigator->getTreeGeneration());
+
+    m_queryAnswer.clear();
+    std::string_view paths{ static_cast<const char*>(query.lpData), query.cbData };
+    while (!paths.empty()) {
+        const auto lineEnd{ paths.find_first_of('\n') };
+        const auto path{ paths.substr(0, lineEnd) };
+        paths.remove_prefix(lineEnd == std::string_view::npos ? paths.size() : lineEnd + 1);
+
+        const auto resolution{ m_queryIndex->resolve(path) };
+        if (query.dwData == resolveQuery) {
+            if (resolution.entry != DirectoryQueryIndex::noEntry) {
+                m_queryIndex->appendFullPath(resolution.entry, m_queryAnswer);
+            }
+        } else if (resolution.isExact) {
+            for (const auto child : m_queryIndex->getChildren(resolution.entry)) {
+                m_queryIndex->appendFullPath(child, m_queryAnswer);
+                m_queryAnswer += '\t';
+            }
+            if (m_queryAnswer.ends_with('\t')) {
+                m_queryAnswer.pop_back();
+            }
         }
-        drawDirectories();
-        break;
-    case VK_UP:
-    case 'W':
-    case 'w':
-        m_navigator->selectionUp();
-        drawDirectories();
-        break;
-    case VK_DOWN:
-    case 'S':
-    case 's':
-        m_navigator->selectionDown();
-        drawDirectories();
-        break;
-    case 'E':
-    case 'e':
-        m_window.hasFocus = false;
-        openExplorerWindow(
-            m_navigator->getCurrentNode()->getFullPath(),
-            isLeftShiftDown ? 0 : m_window.handle
-        );
-        break;
-    case VK_RETURN:
-    case VK_SPACE:
-        openExplorerWindow(
-            m_navigator->getCurrentNode()->getFullPath() + m_navigator->getSelectedChild()->getName(),
-            isLeftShiftDown ? 0 : m_window.handle
-        );
-        break;
-    case VK_ESCAPE:
-    case 'Q':
-    case 'q':
-        ::PostMessage(m_window.handle, WM_QUIT, 0, 0);
-        break;
-    default:
-        break;
+        m_queryAnswer += '\n';
     }
+
+    ::COPYDATASTRUCT answer{
+        .dwData{ query.dwData },
+        .cbData{ static_cast<::DWORD>(m_queryAnswer.size()) },
+        .lpData{ m_queryAnswer.data() },
+    };
+    ::SendMessage(
+        sender,
+        WM_COPYDATA,
+        reinterpret_cast<::WPARAM>(m_window.handle),
+        reinterpret_cast<::LPARAM>(&answer)
+    );
+    return true;
 }
 
 ::LRESULT CALLBACK DirectorySelectWindow::WindowProc(
@@ -291,6 +243,9 @@ void DirectorySelectWindow::handleKeyPress(
 
     static bool isLeftShiftDown{};
 
+    // Taken before any work so the recorded latency covers the whole handling
+    const auto messageTime{ InputLatencyRecorder::Clock::now() };
+
     // Only retrieve thisptr for specific messages
     switch (msg) {
     case WM_KEYDOWN: {
@@ -301,7 +256,13 @@ void DirectorySelectWindow::handleKeyPress(
         const auto thisptr{ reinterpret_cast<DirectorySelectWindow*>(
             ::GetWindowLongPtr(hwnd, GWLP_USERDATA)
         ) };
-        thisptr->handleKeyPress(wParam, lParam, isLeftShiftDown);
+        thisptr->handleKeyPress(wParam, lParam, isLeftShiftDown, messageTime);
+    } return 0;
+    case WM_CHAR: {
+        const auto thisptr{ reinterpret_cast<DirectorySelectWindow*>(
+            ::GetWindowLongPtr(hwnd, GWLP_USERDATA)
+        ) };
+        thisptr->handleCharInput(static_cast<wchar_t>(wParam));
     } return 0;
     case WM_KEYUP:
         if (wParam == VK_SHIFT) {
@@ -313,8 +274,8 @@ void DirectorySelectWindow::handleKeyPress(
             ::GetWindowLongPtr(hwnd, GWLP_USERDATA)
         ) };
         thisptr->m_window.hasFocus = true;
-        if (thisptr->d2d.renderTarget) {
-            thisptr->drawDirectories();
+        if (thisptr->m_view) {
+            thisptr->m_view->drawDirectories();
         }
     } return 0;
     case WM_KILLFOCUS: {
@@ -334,9 +295,24 @@ void DirectorySelectWindow::handleKeyPress(
             justChanged = true;
         } else {
             thisptr->m_window.hasFocus = false;
-            thisptr->drawDirectories();
+            if (thisptr->m_view) {
+                thisptr->m_view->drawDirectories();
+            }
         }
     } return 0;
+    case treeUpdatedMessage: {
+        const auto thisptr{ reinterpret_cast<DirectorySelectWindow*>(
+            ::GetWindowLongPtr(hwnd, GWLP_USERDATA)
+        ) };
+        thisptr->m_view->applyTreeUpdates(thisptr->m_treeLoader->takeUpdates());
+    } return 0;
+    case WM_COPYDATA: {
+        const auto thisptr{ reinterpret_cast<DirectorySelectWindow*>(
+            ::GetWindowLongPtr(hwnd, GWLP_USERDATA)
+        ) };
+        const auto& query{ *reinterpret_cast<const ::COPYDATASTRUCT*>(lParam) };
+        return thisptr->answerQuery(reinterpret_cast<::HWND>(wParam), query);
+    }
     case WM_CLOSE:
         ::PostQuitMessage(0);
         return 0;
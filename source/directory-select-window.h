@@ -1,41 +1,46 @@
 #pragma once
 
+#include "allocation-counter.h"
+#include "d2d-render-backend.h"
+#include "directory-query-index.h"
+#include "directory-search-index.h"
 #include "directory-utils.h"
+#include "directory-view.h"
+#include "key-recording.h"
 #include "resources.h"
+#include "tree-loader.h"
 
-#include <d2d1.h>
-#include <dwrite.h>
-#include <wrl.h>
+#include <optional>
+#include <string>
 
-namespace wrl = Microsoft::WRL;
-
-class DirectorySelectWindow {
+class DirectorySelectWindow : private DirectoryViewHost {
 public:
-    struct StyleConfig {
-        struct {
-            float horizontal{ 25 };
-            float vertical{ 15 };
-        } padding{};
-        float gaps{ 5 };
-        float fontSize{ 25 };
-        float backgroundTint{ .4f };
-    };
+    using StyleConfig = DirectoryView::StyleConfig;
 
     DirectorySelectWindow(
         const std::wstring& title,
         DirectoryNavigator* const navigator,
+        DirectorySearchIndex* const searchIndex,
+        DirectoryQueryIndex* const queryIndex,
+        TreeLoader* const treeLoader,
         const StyleConfig styleConfig = {}
     )
-        : m_backgroundTintColor{ D2D1::ColorF(0.f, 0.f, 0.f, styleConfig.backgroundTint) }
-        , m_styleConfig{ styleConfig }
+        : m_styleConfig{ styleConfig }
         , m_title{ title }
         , m_navigator{ navigator }
+        , m_searchIndex{ searchIndex }
+        , m_queryIndex{ queryIndex }
+        , m_treeLoader{ treeLoader }
     {
         setupWindow();
-        setupDirect2D();
-        
-        fitToContent();
-        drawDirectories();
+        m_renderBackend.emplace(m_window.handle, m_styleConfig.fontSize, m_styleConfig.backgroundTint);
+        m_view.emplace(m_navigator, m_searchIndex, *m_renderBackend, *m_renderBackend, *this, m_styleConfig);
+
+        m_treeLoader->setListener([handle = m_window.handle] {
+            ::PostMessage(handle, treeUpdatedMessage, 0, 0);
+        });
+
+        m_view->refresh();
     }
 
     DirectorySelectWindow(DirectorySelectWindow&) = delete;
@@ -48,27 +53,61 @@ public:
 
     int runMessageLoop() const;
 
+    static constexpr const char* reportPath{ "quick-folder-report.txt" };
+
+    // Other tools query the tree with WM_COPYDATA, wParam their window and dwData one of
+    // these, the data UTF-8 paths each ending with a newline. The answer is sent back the same
+    // way with the same dwData, a line for every path: the full path of the node covering it
+    // for resolveQuery, the full paths of the node's children separated by tabs for childrenQuery.
+    // Lines are empty where no node covers the path.
+    static constexpr ::ULONG_PTR resolveQuery{ 0x51460001 };
+    static constexpr ::ULONG_PTR childrenQuery{ 0x51460002 };
+
+    void writeReport(std::ostream& stream) const {
+        m_view->writeReport(stream);
+    }
+
+    // Every key press given to the view is appended to recording
+    void setKeyRecording(KeyRecording* const recording) {
+        m_keyRecording = recording;
+    }
+
+    void setAllocationCounter(const AllocationCounter* const counter) {
+        m_view->setAllocationCounter(counter);
+    }
+
 private:
+    bool hasFocus() const override {
+        return m_window.hasFocus;
+    }
 
-    // TODO: could redraw only the current child and the previous one
-    // or could even generate one bitmap that is stored in the wrapper
-    // then also add DirectoryNode::m_longestChildWidth to the wrapper
-    void drawDirectories() const;
+    void releaseFocus() override {
+        m_window.hasFocus = false;
+    }
 
-    void cacheNodeSize(DirectoryNode* const node) const;
+    void resizeWindow(const int width, const int height) override;
 
-    void fitToContent();
+    void openExplorer(const std::string_view path, const bool keepOpen) override;
 
-    void setupDirect2D();
+    void writeReport() override;
+
+    void close() override;
 
     void setupWindow();
 
     void handleKeyPress(
         const ::WPARAM keyCode,
         const ::LPARAM lParam,
-        const bool isLeftShiftDown
+        const bool isLeftShiftDown,
+        const InputLatencyRecorder::Clock::time_point inputTime
     );
 
+    // Called with every UTF-16 unit of WM_CHAR
+    void handleCharInput(const wchar_t unit);
+
+    // False if query isn't one of the queries above
+    bool answerQuery(const ::HWND sender, const ::COPYDATASTRUCT& query);
+
     static ::LRESULT CALLBACK WindowProc(
         ::HWND hwnd,
         ::UINT msg,
@@ -76,14 +115,9 @@ private:
         ::LPARAM lParam
     );
 
-    const ::D2D1_COLOR_F m_backgroundTintColor{};
-
     struct {
-        int width{};
-        int height{};
         bool hasFocus{};
         ::HWND handle{};
-        ::D2D1_RECT_F drawableArea{};
     } m_window{};
 
     const StyleConfig m_styleConfig{};
@@ -91,13 +125,24 @@ private:
 
     DirectoryNavigator* const m_navigator;
 
-    struct {
-        wrl::ComPtr<::ID2D1Factory> factory{};
-        wrl::ComPtr<::ID2D1HwndRenderTarget> renderTarget{};
-        wrl::ComPtr<::ID2D1SolidColorBrush> whiteBrush{};
-        wrl::ComPtr<::ID2D1SolidColorBrush> yellowBrush{};
-        wrl::ComPtr<::ID2D1SolidColorBrush> orangeBrush{};
-        wrl::ComPtr<::IDWriteFactory> writeFactory{};
-        wrl::ComPtr<::IDWriteTextFormat> textFormat{};
-    } d2d;
+    DirectorySearchIndex* const m_searchIndex;
+
+    DirectoryQueryIndex* const m_queryIndex;
+
+    // Reused for every answer
+    std::string m_queryAnswer{};
+
+    TreeLoader* const m_treeLoader;
+
+    KeyRecording* m_keyRecording{};
+
+    // Characters outside the BMP arrive as two WM_CHAR messages
+    wchar_t m_highSurrogate{};
+
+    // Posted from the loading thread
+    static constexpr ::UINT treeUpdatedMessage{ WM_APP + 1 };
+
+    // Both need the window handle, so they're created once the window is
+    std::optional<D2DRenderBackend> m_renderBackend{};
+    std::optional<DirectoryView> m_view{};
 };
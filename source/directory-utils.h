@@ -1,16 +1,181 @@
 #pragma once
 
-#define NOMINMAX
-#include <Windows.h>
+#include "file-identity.h"
+#include "filesystem.h"
+#include "utf8.h"
+
 #include <string_view>
 #include <map>
 #include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <ostream>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory_resource>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 
 class DirectoryNode {
 public:
-    using ChildrenMap = std::map<std::wstring, DirectoryNode>;
+    // Children and names come from the memory resource of the node,
+    // children of a map get the map's through uses-allocator construction.
+    // The app builds every root in the pool of its TreeLoader, see getAllocator.
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    // Transparent, so children are looked up by string_view without copying the name
+    using ChildrenMap = std::pmr::map<std::pmr::string, DirectoryNode, std::less<>>;
+
+#ifdef _WIN32
+    static constexpr bool isFileSystemCaseInsensitive{ true };
+#else
+    static constexpr bool isFileSystemCaseInsensitive{ false };
+#endif
+
+    // Config lines starting with it are options, not paths. See findConfigOption
+    static constexpr std::string_view configOptionPrefix{ "#" };
+
+    // Place of a node in the access order of a DirectoryMemoryBudget, a circular list
+    // around a link of the budget. A moved node takes the place of the node it was
+    // moved from, copies start outside of the list.
+    struct AccessLink {
+        AccessLink* previous{};
+        AccessLink* next{};
+        DirectoryNode* node{};
+
+        bool isLinked() const {
+            return next;
+        }
+
+        void linkBefore(AccessLink& position) {
+            unlink();
+            previous = position.previous;
+            next = &position;
+            previous->next = this;
+            position.previous = this;
+        }
+
+        void unlink() {
+            if (!next)
+                return;
+
+            previous->next = next;
+            next->previous = previous;
+            previous = nullptr;
+            next = nullptr;
+        }
 
-    bool readFromString(std::wstring_view contents) {
+        void replace(AccessLink& other) {
+            unlink();
+            if (!other.next)
+                return;
+
+            previous = other.previous;
+            next = other.next;
+            previous->next = this;
+            next->previous = this;
+            other.previous = nullptr;
+            other.next = nullptr;
+        }
+    };
+
+    // Work that was skipped because two paths led to the same directory
+    struct CanonicalizationStats {
+        std::uint64_t duplicateEntries{};
+        std::uint64_t sharedEnumerations{};
+        std::uint64_t refusedCycles{};
+
+        void writeReport(std::ostream& stream) const {
+            stream << "duplicate_entries\tshared_enumerations\trefused_cycles\n"
+                << duplicateEntries
+                << '\t' << sharedEnumerations
+                << '\t' << refusedCycles
+                << '\n';
+        }
+    };
+
+    // Heap held by the names of the tree as UTF-8, next to what the same
+    // names held as std::wstring, as the tree stored them before
+    struct StringMemoryStats {
+        std::uint64_t strings{};
+        std::uint64_t utf8Bytes{};
+        std::uint64_t wideBytes{};
+        std::uint64_t treeBytes{};
+
+        void add(const std::pmr::string& string) {
+            ++strings;
+            utf8Bytes += getStringHeapSize(string);
+            wideBytes += getWideStringHeapSize(string);
+        }
+
+        void writeReport(std::ostream& stream) const {
+            stream << "strings\tutf8_string_bytes\twide_string_bytes\ttree_bytes\twide_tree_bytes\n"
+                << strings
+                << '\t' << utf8Bytes
+                << '\t' << wideBytes
+                << '\t' << treeBytes
+                << '\t' << treeBytes - utf8Bytes + wideBytes
+                << '\n';
+        }
+    };
+
+    // Shared by everything read in one go, so entries
+    // leading to the same directory are only read once
+    // Can be shared by roots read on different threads
+    // What is only needed while reading lives in an arena, freed at once by endBuild
+    // or with the context. It's only touched under the mutex.
+    struct BuildContext {
+        // Takes the allocator of the map it's in, so its names are in the arena as well
+        struct Listing {
+            using allocator_type = std::pmr::polymorphic_allocator<>;
+
+            explicit Listing(const allocator_type& allocator = {})
+                : names{ allocator }
+            {}
+
+            Listing(const Listing& other, const allocator_type& allocator)
+                : names{ other.names, allocator }
+                , isComplete{ other.isComplete }
+            {}
+
+            Listing(Listing&& other, const allocator_type& allocator)
+                : names{ std::move(other.names), allocator }
+                , isComplete{ other.isComplete }
+            {}
+
+            std::pmr::vector<std::pmr::string> names;
+            bool isComplete{};
+        };
+
+        struct Scratch {
+            std::pmr::monotonic_buffer_resource arena{};
+            std::pmr::unordered_map<FileIdentity, Listing, FileIdentityHash> enumerated{ &arena };
+        };
+
+        FileSystem* fileSystem{ &getRealFileSystem() };
+
+        std::mutex mutex{};
+        std::optional<Scratch> scratch{ std::in_place };
+        CanonicalizationStats stats{};
+
+        // Frees the scratch state once nothing more is read with the context, stats stay
+        void endBuild() {
+            const std::lock_guard lock{ mutex };
+            scratch.reset();
+        }
+    };
+
+    bool readFromString(
+        std::string_view contents,
+        CanonicalizationStats* const stats = nullptr,
+        FileSystem& fileSystem = getRealFileSystem()
+    ) {
         if (contents.empty())
             return false;
 
@@ -18,28 +183,204 @@ public:
         m_longestChildName.clear();
         m_longestChildSize = { 0.f, 0.f };
 
-        std::size_t lineEnd{};
-        while (lineEnd != std::wstring_view::npos) {
-            lineEnd = contents.find_first_of(L'\n');
-            this->insertPath(contents.substr(0, lineEnd));
-            contents.remove_prefix(lineEnd + 1);
-        }
+        BuildContext context{ .fileSystem{ &fileSystem } };
+        insertPaths(contents, context);
 
         flattenPaths();
+        if (stats) {
+            *stats = context.stats;
+        }
+        return true;
+    }
+
+    // Adds a single canonicalized entry to a root being built one entry at a time.
+    // Returns the node the entry ends at, nullptr if it doesn't exist or is in the tree already.
+    DirectoryNode* insertEntry(const std::string_view entry, BuildContext& context) {
+        return insertPath(resolveEntry(entry, context), context);
+    }
+
+    // Finishes a root built with insertEntry, its single child flattened the
+    // same way as the children of the root in readFromString
+    std::optional<DirectoryNode> takeSingleChild() {
+        if (m_children.size() != 1)
+            return std::nullopt;
+
+        auto& node{ m_children.begin()->second };
+        node.flattenPaths();
+        return std::optional<DirectoryNode>{ std::move(node) };
+    }
+
+    // Takes the place of a single child, as readFromString does with a single drive
+    // at the top. The child's name follows the node's own after a separator.
+    bool mergeSingleChild() {
+        if (m_children.size() != 1)
+            return false;
+
+        auto& node{ m_children.begin()->second };
+        m_name += '\\';
+        m_name += node.m_name;
+        m_longestChildName = node.m_longestChildName;
+        m_longestChildSize = node.m_longestChildSize;
+        m_accessLink.replace(node.m_accessLink);
+        m_isEnumerated = node.m_isEnumerated;
+        m_isEvicted = node.m_isEvicted;
+        m_isStale = node.m_isStale;
+
+        // node is one of the children being replaced
+        auto newChildren{ std::move(node.m_children) };
+        m_children = std::move(newChildren);
+        for (auto& [_, child] : m_children) {
+            child.m_parent = this;
+        }
         return true;
     }
 
-    DirectoryNode(const std::wstring_view name = L"/", DirectoryNode* parent = nullptr)
-        : m_name{ name }
+    // Reverse of serialize, every node read is marked as stale
+    static std::optional<DirectoryNode> deserialize(std::string_view text, const allocator_type& allocator = {}) {
+        std::optional<DirectoryNode> root{};
+        std::vector<DirectoryNode*> stack{};
+
+        std::size_t lineEnd{};
+        while (lineEnd != std::string_view::npos) {
+            lineEnd = text.find_first_of('\n');
+            const auto line{ text.substr(0, lineEnd) };
+            text.remove_prefix(lineEnd + 1);
+
+            const auto tab{ line.find_first_of('\t') };
+            if (tab == std::string_view::npos)
+                continue;
+
+            std::size_t depth{};
+            std::size_t i{};
+            for (; i < tab && line[i] >= '0' && line[i] <= '9'; ++i) {
+                depth = depth * 10 + static_cast<std::size_t>(line[i] - '0');
+            }
+            const bool isEnumerated{ line.substr(i, tab - i) == serializedEnumeratedFlag };
+            const auto name{ line.substr(tab + 1) };
+
+            DirectoryNode* node{};
+            if (!depth && !root) {
+                node = &root.emplace(name, nullptr, allocator);
+            } else if (depth && depth <= stack.size()) {
+                node = stack[depth - 1]->appendChild(name);
+            } else {
+                return std::nullopt;
+            }
+
+            node->m_isEnumerated = isEnumerated;
+            node->m_isStale = true;
+            stack.resize(depth);
+            stack.push_back(node);
+        }
+        return root;
+    }
+
+    // Writes the subtree one node per line as <depth><flags>\t<name>
+    void serialize(std::string& text, const std::size_t depth = 0) const {
+        text += std::to_string(depth);
+        if (m_isEnumerated) {
+            text += serializedEnumeratedFlag;
+        }
+        text += '\t';
+        text += std::string_view{ m_name }.substr(0, m_name.find_last_not_of(explicitPathEnding) + 1);
+        text += '\n';
+
+        for (const auto& [_, node] : m_children) {
+            node.serialize(text, depth + 1);
+        }
+    }
+
+    // Adds a finished subtree as a child, replacing one with the same name.
+    // A child from another memory resource is copied into this one.
+    DirectoryNode* adoptChild(DirectoryNode&& child) {
+        std::pmr::string name{ child.m_name, m_children.get_allocator() };
+        auto& node{ m_children.insert_or_assign(std::move(name), std::move(child)).first->second };
+        node.m_parent = this;
+
+        if (node.m_name.length() > m_longestChildName.length()) {
+            m_longestChildName = node.m_name;
+            m_longestChildSize = { 0.f, 0.f };
+        }
+        return &node;
+    }
+
+    void removeChild(const std::string_view name) {
+        if (const auto child{ m_children.find(name) }; child != m_children.end()) {
+            m_children.erase(child);
+        }
+
+        m_longestChildName.clear();
+        m_longestChildSize = { 0.f, 0.f };
+        for (const auto& [childName, _] : m_children) {
+            if (childName.length() > m_longestChildName.length()) {
+                m_longestChildName = childName;
+            }
+        }
+    }
+
+    // Trims the line, unifies separators, uppercases the drive letter
+    // and removes trailing separators so D:\OBS\ and d:/OBS are the same entry
+    static std::string canonicalizePath(std::string_view path) {
+        constexpr std::string_view whitespace{ " \t\r" };
+        const auto first{ path.find_first_not_of(whitespace) };
+        if (first == std::string_view::npos)
+            return {};
+
+        path = path.substr(first, path.find_last_not_of(whitespace) - first + 1);
+
+        std::string result{};
+        result.reserve(path.size());
+        for (const char character : path) {
+            const char normalized{ character == '/' ? '\\' : character };
+
+            // Size check keeps the leading double separator of UNC paths
+            if (normalized == '\\' && result.size() > 1 && result.back() == '\\')
+                continue;
+
+            result += normalized;
+        }
+
+        const bool isWildcard{ result.ends_with("\\*") };
+        if (isWildcard) {
+            result.resize(result.size() - 2);
+        }
+        while (result.size() > 2 && result.back() == '\\') {
+            result.pop_back();
+        }
+        if (isWildcard) {
+            result += "\\*";
+        }
+
+        if (result.size() >= 2 && result[1] == ':' && result[0] >= 'a' && result[0] <= 'z') {
+            result[0] = static_cast<char>(result[0] - 'a' + 'A');
+        }
+        return result;
+    }
+
+    DirectoryNode(
+        const std::string_view name = "/",
+        DirectoryNode* parent = nullptr,
+        const allocator_type& allocator = {}
+    )
+        : m_name{ name, allocator }
+        , m_children{ allocator }
         , m_parent{ parent }
+        , m_longestChildName{ allocator }
+    {}
+
+    DirectoryNode(const DirectoryNode& other)
+        : DirectoryNode{ other, allocator_type{} }
     {}
 
-    DirectoryNode(DirectoryNode& other)
-        : m_name{ other.m_name }
-        , m_children{ other.m_children }
+    DirectoryNode(const DirectoryNode& other, const allocator_type& allocator)
+        : m_name{ other.m_name, allocator }
+        , m_children{ other.m_children, allocator }
         , m_parent{ nullptr }
-        , m_longestChildName{ other.m_longestChildName }
+        , m_longestChildName{ other.m_longestChildName, allocator }
         , m_longestChildSize{ other.m_longestChildSize }
+        , m_isEnumerated{ other.m_isEnumerated }
+        , m_isEvicted{ other.m_isEvicted }
+        , m_isStale{ other.m_isStale }
     {
         for (auto& [_, node] : m_children) {
             node.m_parent = this;
@@ -47,15 +388,28 @@ public:
     }
 
     DirectoryNode(DirectoryNode&& other) noexcept
-        : m_name{ std::move(other.m_name) }
-        , m_children{ std::move(other.m_children) }
+        : DirectoryNode{ std::move(other), other.get_allocator() }
+    {}
+
+    // Moves the nodes if allocator uses the same resource, copies them otherwise
+    DirectoryNode(DirectoryNode&& other, const allocator_type& allocator)
+        : m_name{ std::move(other.m_name), allocator }
+        , m_children{ std::move(other.m_children), allocator }
         , m_parent{ nullptr }
-        , m_longestChildName{ other.m_longestChildName }
+        , m_longestChildName{ std::move(other.m_longestChildName), allocator }
         , m_longestChildSize{ other.m_longestChildSize }
+        , m_isEnumerated{ other.m_isEnumerated }
+        , m_isEvicted{ other.m_isEvicted }
+        , m_isStale{ other.m_isStale }
     {
         for (auto& [_, node] : m_children) {
             node.m_parent = this;
         }
+        m_accessLink.replace(other.m_accessLink);
+    }
+
+    ~DirectoryNode() {
+        m_accessLink.unlink();
     }
 
     DirectoryNode& operator=(const DirectoryNode& other) {
@@ -67,6 +421,9 @@ public:
         m_parent = nullptr;
         m_longestChildName = other.m_longestChildName;
         m_longestChildSize = other.m_longestChildSize;
+        m_isEnumerated = other.m_isEnumerated;
+        m_isEvicted = other.m_isEvicted;
+        m_isStale = other.m_isStale;
 
         for (auto& [_, node] : m_children) {
             node.m_parent = this;
@@ -81,19 +438,27 @@ public:
         m_name = std::move(other.m_name);
         m_children = std::move(other.m_children);
         m_parent = nullptr;
-        m_longestChildName = other.m_longestChildName;
+        m_longestChildName = std::move(other.m_longestChildName);
         m_longestChildSize = other.m_longestChildSize;
+        m_isEnumerated = other.m_isEnumerated;
+        m_isEvicted = other.m_isEvicted;
+        m_isStale = other.m_isStale;
 
         for (auto& [_, node] : m_children) {
             node.m_parent = this;
         }
+        m_accessLink.replace(other.m_accessLink);
         return *this;
     }
 
-    std::wstring getName() const {
+    std::string_view getName() const {
         return m_name;
     }
 
+    allocator_type get_allocator() const {
+        return m_children.get_allocator();
+    }
+
     ChildrenMap::iterator begin() {
         return m_children.begin();
     }
@@ -106,16 +471,124 @@ public:
         return m_children.size();
     }
 
+    // Evicted nodes report their children even though they are not loaded
+    bool hasChildren() const {
+        return !m_children.empty() || m_isEvicted;
+    }
+
+    bool isEvicted() const {
+        return m_isEvicted;
+    }
+
+    // Only children read from the disk can be dropped and read again later
+    bool isEvictable() const {
+        return m_isEnumerated && !m_isEvicted;
+    }
+
+    // Drops the children read from the disk and returns the memory they held.
+    // What the config added below them is kept, the reload lists it again.
+    std::size_t evictChildren() {
+        const auto size{ getEvictableMemoryUsage() };
+        std::erase_if(m_children, [](const auto& child) { return !child.second.isKeptOnEviction(); });
+        m_isEvicted = true;
+        return size;
+    }
+
+    // Returns the memory the children read held, as evictChildren would drop it again
+    std::size_t reloadChildren(FileSystem& fileSystem = getRealFileSystem()) {
+        m_isEvicted = false;
+        m_longestChildName.clear();
+        m_longestChildSize = { 0.f, 0.f };
+        for (const auto& [name, _] : m_children) {
+            if (name.length() > m_longestChildName.length()) {
+                m_longestChildName = name;
+            }
+        }
+        enumerateChildren(fileSystem, nullptr);
+        return getEvictableMemoryUsage();
+    }
+
+    // Read from the cache or the config alone, the disk wasn't checked yet
+    bool isStale() const {
+        return m_isStale;
+    }
+
+    // Replaces a stale listing with a fresh one, children still listed keep their subtrees
+    void refreshChildren(const std::span<const std::string> names) {
+        const std::unordered_set<std::string_view> listed{ names.begin(), names.end() };
+        std::erase_if(m_children, [&](const auto& child) { return !listed.contains(child.first); });
+
+        m_longestChildName.clear();
+        m_longestChildSize = { 0.f, 0.f };
+        for (const auto& [name, _] : m_children) {
+            if (name.length() > m_longestChildName.length()) {
+                m_longestChildName = name;
+            }
+        }
+        for (const auto& name : names) {
+            appendChild(name);
+        }
+
+        m_isEnumerated = true;
+        m_isStale = false;
+    }
+
+    void markStale() {
+        m_isStale = true;
+        for (auto& [_, node] : m_children) {
+            node.markStale();
+        }
+    }
+
+    AccessLink& getAccessLink() {
+        return m_accessLink;
+    }
+
+    // Approximation of the heap memory held by this node and its subtree
+    std::size_t getMemoryUsage() const {
+        return sizeof(*this)
+            + getStringHeapSize(m_name)
+            + getStringHeapSize(m_longestChildName)
+            + getChildrenMemoryUsage();
+    }
+
+    std::size_t getChildrenMemoryUsage() const {
+        std::size_t size{};
+        for (const auto& [name, node] : m_children) {
+            size += mapNodeOverhead + getStringHeapSize(name) + node.getMemoryUsage();
+        }
+        return size;
+    }
+
+    StringMemoryStats getStringMemoryStats() const {
+        StringMemoryStats stats{ .treeBytes{ getMemoryUsage() } };
+        collectStringMemory(stats);
+        return stats;
+    }
+
     const ChildrenMap& getChildren() const {
         return m_children;
     }
 
-    DirectoryNode& getChild(const std::wstring& childName) {
-        return m_children.at(childName);
+    // Throws std::out_of_range like std::map::at if there is no such child
+    DirectoryNode& getChild(const std::string_view childName) {
+        const auto child{ m_children.find(childName) };
+        if (child == m_children.end())
+            throw std::out_of_range{ "no such child" };
+
+        return child->second;
+    }
+
+    const DirectoryNode& getChild(const std::string_view childName) const {
+        return const_cast<DirectoryNode*>(this)->getChild(childName);
+    }
+
+    ChildrenMap::iterator findChild(const std::string_view childName) {
+        return m_children.find(childName);
     }
 
-    const DirectoryNode& getChild(const std::wstring& childName) const {
-        return m_children.at(childName);
+    ChildrenMap::const_iterator findChild(const std::string_view childName) const {
+        return m_children.find(childName);
     }
 
     DirectoryNode* getParent() {
@@ -126,7 +599,7 @@ public:
         return m_parent;
     }
 
-    std::wstring_view getLongestChildName() const {
+    std::string_view getLongestChildName() const {
         return m_longestChildName;
     }
 
@@ -144,64 +617,255 @@ public:
         return m_longestChildSize;
     }
 
-    std::wstring getFullPath() {
-        std::wstring path{};
-        DirectoryNode* node{ this };
-        while (node->getParent()) {
-            auto nodeName{ node->getName() };
-            if (nodeName.ends_with(explicitPathEnding)) {
-                nodeName.pop_back();
-            }
-            path = nodeName + L'\\' + path;
-            node = node->getParent();
-        }
+    std::string getFullPath() const {
+        std::string path{};
+        appendFullPath(path);
         return path;
     }
 
+    // Every name followed by a separator, starting with a drive flattened into the
+    // top node. Sized up front and written back to front, so reusing path doesn't
+    // allocate once it held a longer one.
+    void appendFullPath(std::string& path) const {
+        const auto start{ path.size() };
+        std::size_t length{};
+        auto top{ this };
+        for (; top->m_parent; top = top->m_parent) {
+            length += getPathName(top->m_name).length() + 1;
+        }
+
+        const auto topPath{ getFlattenedTopPath(top->m_name) };
+        if (!topPath.empty()) {
+            length += topPath.length() + 1;
+        }
+
+        path.resize(start + length);
+        if (!topPath.empty()) {
+            path.replace(start, topPath.length(), topPath);
+            path[start + topPath.length()] = '\\';
+        }
+        auto end{ path.size() };
+        for (auto node{ this }; node->m_parent; node = node->m_parent) {
+            const auto name{ getPathName(node->m_name) };
+            path[--end] = '\\';
+            end -= name.length();
+            path.replace(end, name.length(), name);
+        }
+    }
+
 private:
-    DirectoryNode* appendChild(const std::wstring_view name) {
+    // What readFromString appended to the name of the top node, e.g. D: for /\D:
+    static std::string_view getFlattenedTopPath(const std::string_view name) {
+        const auto separator{ name.find('\\') };
+        return separator == std::string_view::npos ? std::string_view{} : name.substr(separator + 1);
+    }
+
+    // Children only get children of their own or a listing through the config
+    bool isKeptOnEviction() const {
+        return hasChildren() || m_isEnumerated;
+    }
+
+    std::size_t getEvictableMemoryUsage() const {
+        std::size_t size{};
+        for (const auto& [name, node] : m_children) {
+            if (!node.isKeptOnEviction()) {
+                size += mapNodeOverhead + getStringHeapSize(name) + node.getMemoryUsage();
+            }
+        }
+        return size;
+    }
+
+    // Without the marker of explicit entries, only names still being read have it
+    static std::string_view getPathName(const std::string_view name) {
+        return name.ends_with(explicitPathEnding) ? name.substr(0, name.length() - 1) : name;
+    }
+
+    DirectoryNode* appendChild(const std::string_view name) {
 
         // Spectre mitigation
         bool isNewLongest{ name.length() > m_longestChildName.length() };
         if (isNewLongest) {
             m_longestChildName = name;
         }
-        return &m_children.try_emplace(
-            std::wstring{ name },
-            name,
-            this
-        ).first->second;
+
+        // The key is only copied when the child is new
+        const auto child{ m_children.lower_bound(name) };
+        if (child != m_children.end() && child->first == name)
+            return &child->second;
+
+        return &m_children.emplace_hint(
+            child,
+            std::piecewise_construct,
+            std::forward_as_tuple(name),
+            std::forward_as_tuple(name, this)
+        )->second;
     }
 
-    void insertPath(std::wstring_view path) noexcept {
-        const auto basePath{ path.ends_with('*')
-            ? path.substr(0, path.length() - 1)
-            : path
-        };
-        if (!std::filesystem::exists(basePath))
-            return;
+    // Reuses an existing child that only differs in case on case insensitive file systems
+    DirectoryNode* appendPathComponent(const std::string_view name) {
+        if constexpr (isFileSystemCaseInsensitive) {
+            if (m_children.find(name) == m_children.end()) {
+                for (auto& [childName, child] : m_children) {
+                    if (utf8::equalsIgnoringCase(childName, name))
+                        return &child;
+                }
+            }
+        }
+        return appendChild(name);
+    }
 
+    void enumerateChildren(FileSystem& fileSystem, BuildContext* const context) noexcept {
+        const auto directory{ getFullPath() };
+        fileSystem.listDirectories(directory, [&](const FileSystem::DirectoryEntry& entry) {
+            if (entry.isLink && isLinkToAncestor(fileSystem, directory + entry.name, directory)) {
+                if (context) {
+                    const std::lock_guard lock{ context->mutex };
+                    ++context->stats.refusedCycles;
+                }
+                return;
+            }
+
+            appendChild(entry.name);
+        });
+        m_isEnumerated = true;
+    }
+
+    // directory ends with a separator, so does every ancestor checked
+    static bool isLinkToAncestor(
+        FileSystem& fileSystem,
+        const std::string& link,
+        const std::string_view directory
+    ) noexcept {
+        const auto target{ fileSystem.getIdentity(link) };
+        if (!target)
+            return false;
+
+        std::string_view ancestor{ directory };
+        while (!ancestor.empty()) {
+            if (fileSystem.getIdentity(ancestor) == target)
+                return true;
+
+            const auto separator{ ancestor.substr(0, ancestor.size() - 1).find_last_of('\\') };
+            if (separator == std::string_view::npos)
+                return false;
+
+            ancestor = ancestor.substr(0, separator + 1);
+        }
+        return false;
+    }
+
+    // A canonicalized entry checked against the file system, path is the entry's own
+    struct ResolvedEntry {
+        std::string_view path{};
+        std::optional<FileIdentity> identity{};
+        bool exists{};
+    };
+
+    // Checks that the entry exists and finds its directory, nothing is read yet
+    static ResolvedEntry resolveEntry(const std::string_view entry, BuildContext& context) {
+        ResolvedEntry resolved{ .path{ entry } };
+        if (entry.empty())
+            return resolved;
+
+        auto& fileSystem{ *context.fileSystem };
+        const auto basePath{ getBasePath(entry) };
+        resolved.exists = fileSystem.exists(basePath);
+        if (resolved.exists) {
+            resolved.identity = fileSystem.getIdentity(basePath);
+        }
+        return resolved;
+    }
+
+    void insertPaths(std::string_view contents, BuildContext& context) {
+        std::size_t lineEnd{};
+        while (lineEnd != std::string_view::npos) {
+            lineEnd = contents.find_first_of('\n');
+            const auto line{ contents.substr(0, lineEnd) };
+            if (!line.starts_with(configOptionPrefix)) {
+                const auto entry{ canonicalizePath(line) };
+                this->insertPath(resolveEntry(entry, context), context);
+            }
+            contents.remove_prefix(lineEnd + 1);
+        }
+    }
+
+    // Without the trailing * of wildcard entries
+    static std::string_view getBasePath(const std::string_view entry) {
+        return entry.ends_with('*') ? entry.substr(0, entry.length() - 1) : entry;
+    }
+
+    void copyChildrenFrom(const std::pmr::vector<std::pmr::string>& names) {
+        for (const auto& name : names) {
+            appendChild(name);
+        }
+        m_isEnumerated = true;
+    }
+
+    // Returns the node the entry ends at, nullptr if it doesn't exist or is in the tree already.
+    // Entries differing only in case or separators end at the same node and are read once.
+    // An entry reaching a directory read before under another path, e.g. through a junction,
+    // gets a copy of its listing under its own name, whichever of them is read first.
+    DirectoryNode* insertPath(const ResolvedEntry& entry, BuildContext& context) noexcept {
+        if (!entry.exists)
+            return nullptr;
+
+        auto path{ entry.path };
+        const auto& identity{ entry.identity };
+        auto& fileSystem{ *context.fileSystem };
         DirectoryNode* node{ this };
 
         std::size_t backslashPos{};
-        while (backslashPos != std::wstring_view::npos) {
-            backslashPos = path.find_first_of(L'\\');
+        while (backslashPos != std::string_view::npos) {
+            backslashPos = path.find_first_of('\\');
 
-            if (path.front() != L'*') {
-                node = node->appendChild(path.substr(0, backslashPos));
+            if (path.front() != '*') {
+                node = node->appendPathComponent(path.substr(0, backslashPos));
                 path.remove_prefix(backslashPos + 1);
                 continue;
             }
 
-            for (const auto& dir : std::filesystem::directory_iterator{ node->getFullPath() }) {
-                if (!dir.is_directory())
-                    continue;
+            if (node->m_isEnumerated) {
+                const std::lock_guard lock{ context.mutex };
+                ++context.stats.duplicateEntries;
+                return nullptr;
+            }
+
+            if (identity) {
+                std::unique_lock lock{ context.mutex };
+                const auto& listing{ context.scratch->enumerated[*identity] };
+                if (listing.isComplete) {
+                    node->copyChildrenFrom(listing.names);
+                    ++context.stats.sharedEnumerations;
+                    break;
+                }
+            }
+
+            // Two roots reading the same directory at the same time both read it
+            node->enumerateChildren(fileSystem, &context);
 
-                node->appendChild(dir.path().filename().wstring());
+            if (identity) {
+                const std::lock_guard lock{ context.mutex };
+                auto& listing{ context.scratch->enumerated[*identity] };
+                if (!listing.isComplete) {
+                    for (const auto& [name, _] : node->m_children) {
+                        listing.names.emplace_back(name);
+                    }
+                    listing.isComplete = true;
+                }
             }
             break;
         }
-        node->m_name += explicitPathEnding;
+
+        if (node->m_name.ends_with(explicitPathEnding)) {
+            if (!entry.path.ends_with('*')) {
+                const std::lock_guard lock{ context.mutex };
+                ++context.stats.duplicateEntries;
+                return nullptr;
+            }
+        } else {
+            node->m_name += explicitPathEnding;
+        }
+        return node;
     }
 
     bool flattenPaths() noexcept {
@@ -221,9 +885,12 @@ private:
                 m_name.pop_back();
                 return false;
             }
-            m_name += L"\\" + node.m_name;
+            m_name += '\\';
+            m_name += node.m_name;
+            m_isEnumerated = node.m_isEnumerated;
 
-            auto newChildren{ node.m_children };
+            // node is one of the children being replaced
+            auto newChildren{ std::move(node.m_children) };
             m_children = std::move(newChildren);
             for (auto& [_, childNode] : m_children) {
                 childNode.m_parent = this;
@@ -254,50 +921,275 @@ private:
         return false;
     }
 
-    std::wstring m_name{};
+    std::pmr::string m_name{};
     ChildrenMap m_children{};
     DirectoryNode* m_parent{};
-    std::wstring m_longestChildName{};
+    std::pmr::string m_longestChildName{};
     Rect m_longestChildSize{};
+    AccessLink m_accessLink{ .node{ this } };
+    bool m_isEnumerated{};
+    bool m_isEvicted{};
+    bool m_isStale{};
+
+    static constexpr std::string_view serializedEnumeratedFlag{ "*" };
+
+    void collectStringMemory(StringMemoryStats& stats) const {
+        stats.add(m_name);
+        stats.add(m_longestChildName);
+        for (const auto& [name, node] : m_children) {
+            stats.add(name);
+            node.collectStringMemory(stats);
+        }
+    }
+
+    static std::size_t getStringHeapSize(const std::pmr::string& string) {
+        const auto data{ reinterpret_cast<const char*>(string.data()) };
+        const auto object{ reinterpret_cast<const char*>(&string) };
+        const bool isInline{ data >= object && data < object + sizeof(string) };
+        return isInline ? 0 : string.capacity() + 1;
+    }
+
+    // What string would hold as std::wstring, whose characters are 2 bytes on Windows
+    // and 4 elsewhere. Rounding up of the capacity is left out.
+    static std::size_t getWideStringHeapSize(const std::pmr::string& string) {
+        static const std::size_t inlineCapacity{ std::wstring{}.capacity() };
+        const auto length{ utf8::getWideLength(string) };
+        return length <= inlineCapacity ? 0 : (length + 1) * sizeof(wchar_t);
+    }
+
+    // Left, right and parent pointers with the color, followed by the key
+    static constexpr std::size_t mapNodeOverhead{ 4 * sizeof(void*) + sizeof(std::pmr::string) };
 
     // Fixes
     // C:\Users
     // C:\Users\user\Downloads
     // Being flattened into C:\Users\user\Downloads
-    static const char explicitPathEnding{ L'|' };
+    static const char explicitPathEnding{ '|' };
+};
+
+
+// Looks for a line in the form of #name=value
+inline std::optional<std::string_view> findConfigOption(
+    std::string_view contents,
+    const std::string_view name
+) {
+    std::size_t lineEnd{};
+    while (lineEnd != std::string_view::npos) {
+        lineEnd = contents.find_first_of('\n');
+        auto line{ contents.substr(0, lineEnd) };
+        contents.remove_prefix(lineEnd + 1);
+
+        if (line.ends_with('\r')) {
+            line.remove_suffix(1);
+        }
+        if (!line.starts_with(DirectoryNode::configOptionPrefix))
+            continue;
+
+        line.remove_prefix(DirectoryNode::configOptionPrefix.size());
+        if (line.starts_with(name) && line.substr(name.size()).starts_with('='))
+            return line.substr(name.size() + 1);
+    }
+    return std::nullopt;
+}
+
+
+// Keeps the tree under a memory budget by dropping children read from the disk
+// of the least recently visited levels. They are read again once entered.
+// Levels are kept in access order in a list through the nodes, so enforcing
+// the budget only looks at the levels it evicts.
+class DirectoryMemoryBudget {
+public:
+    // The search index counts against the budget as well, names it keeps of
+    // evicted levels are part of its bytes
+    struct Stats {
+        std::size_t budgetBytes{};
+        std::size_t residentBytes{};
+        std::size_t indexBytes{};
+        std::size_t evictedNameBytes{};
+        std::size_t evictedBytes{};
+        std::uint64_t evictions{};
+        std::uint64_t reloads{};
+    };
+
+    // Share of the budget the search index can spend on names of evicted levels
+    static constexpr std::size_t evictedNameShare{ 16 };
+
+    DirectoryMemoryBudget(const std::size_t budgetBytes)
+        : m_stats{ .budgetBytes{ budgetBytes } }
+    {
+        m_accessOrder.previous = &m_accessOrder;
+        m_accessOrder.next = &m_accessOrder;
+    }
+
+    // Nodes point at m_accessOrder
+    DirectoryMemoryBudget(const DirectoryMemoryBudget&) = delete;
+    DirectoryMemoryBudget& operator=(const DirectoryMemoryBudget&) = delete;
+
+    ~DirectoryMemoryBudget() {
+        while (m_accessOrder.next != &m_accessOrder) {
+            m_accessOrder.next->unlink();
+        }
+    }
+
+    // Starts counting a subtree added to the tree, its levels count as the least recently visited
+    void attach(DirectoryNode& subtree) {
+        m_stats.residentBytes += subtree.getMemoryUsage();
+        linkLevels(subtree);
+    }
+
+    // Stops counting a subtree about to be removed or changed,
+    // levels destroyed leave the access order on their own
+    void detach(const DirectoryNode& subtree) {
+        m_stats.residentBytes -= std::min(subtree.getMemoryUsage(), m_stats.residentBytes);
+    }
+
+    // The path from the root is visited as well, the node last
+    void touch(DirectoryNode* const node) {
+        auto position{ &m_accessOrder };
+        for (auto level{ node }; level; level = level->getParent()) {
+            if (level->isEvictable()) {
+                level->getAccessLink().linkBefore(*position);
+                position = &level->getAccessLink();
+            }
+        }
+    }
+
+    void reload(DirectoryNode* const node, FileSystem& fileSystem) {
+        m_stats.residentBytes += node->reloadChildren(fileSystem);
+        node->getAccessLink().linkBefore(m_accessOrder);
+        ++m_stats.reloads;
+    }
+
+    void setIndexUsage(const std::size_t indexBytes, const std::size_t evictedNameBytes) {
+        m_stats.indexBytes = indexBytes;
+        m_stats.evictedNameBytes = evictedNameBytes;
+    }
+
+    std::size_t getEvictedNameLimit() const {
+        return m_stats.budgetBytes / evictedNameShare;
+    }
+
+    // Every node from the root to pinned is left untouched
+    void enforce(const DirectoryNode* const pinned) {
+        if (m_stats.residentBytes + m_stats.indexBytes <= m_stats.budgetBytes)
+            return;
+
+        m_pinnedPath.clear();
+        for (auto node{ pinned }; node; node = node->getParent()) {
+            m_pinnedPath.push_back(node);
+        }
+
+        // Evicts a bit more than needed so the next few reloads don't evict again.
+        // The index shrinks along with the tree once it's built again, so the tree
+        // only has to get down to its share of the target.
+        // Children dropped are never in the list, so next stays valid.
+        const auto residentShare{ static_cast<double>(m_stats.residentBytes) / static_cast<double>(m_stats.residentBytes + m_stats.indexBytes) };
+        const auto target{ static_cast<std::size_t>(static_cast<double>(m_stats.budgetBytes / 10 * 9) * residentShare) };
+        auto link{ m_accessOrder.next };
+        while (link != &m_accessOrder && m_stats.residentBytes > target) {
+            const auto node{ link->node };
+            link = link->next;
+            if (std::find(m_pinnedPath.begin(), m_pinnedPath.end(), node) != m_pinnedPath.end())
+                continue;
+
+            const auto size{ node->evictChildren() };
+            node->getAccessLink().unlink();
+            m_stats.residentBytes -= std::min(size, m_stats.residentBytes);
+            m_stats.evictedBytes += size;
+            ++m_stats.evictions;
+        }
+    }
+
+    const Stats& getStats() const {
+        return m_stats;
+    }
+
+    void writeReport(std::ostream& stream) const {
+        stream << "budget_bytes\tresident_bytes\tindex_bytes\tevicted_name_bytes\tevicted_bytes\tevictions\treloads\n"
+            << m_stats.budgetBytes
+            << '\t' << m_stats.residentBytes
+            << '\t' << m_stats.indexBytes
+            << '\t' << m_stats.evictedNameBytes
+            << '\t' << m_stats.evictedBytes
+            << '\t' << m_stats.evictions
+            << '\t' << m_stats.reloads
+            << '\n';
+    }
+
+private:
+    void linkLevels(DirectoryNode& node) {
+        if (node.isEvictable() && !node.getAccessLink().isLinked()) {
+            node.getAccessLink().linkBefore(*m_accessOrder.next);
+        }
+        for (auto& [_, child] : node) {
+            if (child.getChildCount()) {
+                linkLevels(child);
+            }
+        }
+    }
+
+    Stats m_stats{};
+    DirectoryNode::AccessLink m_accessOrder{};
+    std::vector<const DirectoryNode*> m_pinnedPath{};
 };
 
 
 class DirectoryNavigator {
 public:
-    DirectoryNavigator(DirectoryNode* const root)
-        : m_currentNode{ root }
+    using FocusListener = std::function<void(DirectoryNode& current, DirectoryNode* selected)>;
+
+    // Evicted levels are read again from fileSystem, the one the tree was built from
+    DirectoryNavigator(
+        DirectoryNode* const root,
+        DirectoryMemoryBudget* const memoryBudget = nullptr,
+        FileSystem& fileSystem = getRealFileSystem()
+    )
+        : m_root{ root }
+        , m_currentNode{ root }
         , m_childIterator{ m_currentNode->begin() }
+        , m_memoryBudget{ memoryBudget }
+        , m_fileSystem{ fileSystem }
     {
         std::advance(m_childIterator, m_currentNode->getChildCount() / 2);
+        if (m_memoryBudget) {
+            m_memoryBudget->attach(*m_root);
+        }
     }
 
     void selectionDown() {
+        if (!m_currentNode->getChildCount())
+            return;
+
         ++m_childIterator;
         if (m_childIterator == m_currentNode->end()) {
             m_childIterator = m_currentNode->begin();
         }
+        notifyFocus();
     }
 
     void selectionUp() {
+        if (!m_currentNode->getChildCount())
+            return;
+
         if (m_childIterator == m_currentNode->begin()) {
             m_childIterator = m_currentNode->end();
         }
         --m_childIterator;
+        notifyFocus();
     }
 
     bool enterSelected() {
+        if (!getSelectedChild())
+            return false;
+
+        loadChildren(getSelectedChild());
         if (!getSelectedChild()->getChildCount())
             return false;
 
         m_currentNode = getSelectedChild();
         m_childIterator = m_currentNode->begin();
         std::advance(m_childIterator, m_currentNode->getChildCount() / 2);
+        visitCurrentNode();
         return true;
     }
 
@@ -308,19 +1200,254 @@ public:
         m_currentNode = m_currentNode->getParent();
         m_childIterator = m_currentNode->begin();
         std::advance(m_childIterator, m_currentNode->getChildCount() / 2);
+        visitCurrentNode();
+        return true;
+    }
+
+    // Moves to the parent of node with node selected
+    bool selectNode(DirectoryNode* const node) {
+        if (!focusNode(node))
+            return false;
+
+        enforceMemoryBudget();
         return true;
     }
 
+    // Walks down child names from the root, reading evicted levels on the way
+    bool selectPath(const std::span<const std::string_view> names) {
+        DirectoryNode* node{ m_root };
+        for (const auto name : names) {
+            loadChildren(node);
+            const auto child{ node->findChild(name) };
+            if (child == node->end())
+                return false;
+
+            node = &child->second;
+        }
+        return selectNode(node);
+    }
+
+    DirectoryMemoryBudget* getMemoryBudget() const {
+        return m_memoryBudget;
+    }
+
+    void enforceMemoryBudget() {
+        if (!m_memoryBudget)
+            return;
+
+        const auto evictions{ m_memoryBudget->getStats().evictions };
+        m_memoryBudget->enforce(m_currentNode);
+        if (m_memoryBudget->getStats().evictions != evictions) {
+            ++m_treeGeneration;
+        }
+    }
+
+    // Changes whenever nodes are added to or removed from the tree, so what is
+    // built from the tree can tell it's stale
+    std::uint64_t getTreeGeneration() const {
+        return m_treeGeneration;
+    }
+
+    DirectoryNode* getRoot() const {
+        return m_root;
+    }
+
     DirectoryNode* getCurrentNode() const {
         return m_currentNode;
     }
 
+    // nullptr while the current node has no children yet
     DirectoryNode* getSelectedChild() const {
+        if (m_childIterator == m_currentNode->end())
+            return nullptr;
+
         return &m_childIterator->second;
     }
 
+    // Swaps a root read earlier for a newer read of it, either can be missing.
+    // The nodes of the old root are destroyed, so the selection is kept by names.
+    // The memory budget is left to enforceMemoryBudget, so the new root can be indexed whole first.
+    // Returns the new root.
+    DirectoryNode* replaceRoot(const std::string_view replacedName, std::optional<DirectoryNode>&& node) {
+        const auto selectedPath{ getSelectedPath() };
+        if (!replacedName.empty()) {
+            if (const auto replaced{ m_root->findChild(replacedName) }; m_memoryBudget && replaced != m_root->end()) {
+                m_memoryBudget->detach(replaced->second);
+            }
+            m_root->removeChild(replacedName);
+        }
+
+        DirectoryNode* root{};
+        if (node) {
+            root = m_root->adoptChild(std::move(*node));
+            if (m_memoryBudget) {
+                m_memoryBudget->attach(*root);
+            }
+        }
+        ++m_treeGeneration;
+        restoreSelectedPath(selectedPath);
+        return root;
+    }
+
+    // Gives a stale directory its fresh listing, nullptr if it isn't shown or isn't stale.
+    // Like replaceRoot, it leaves the memory budget to enforceMemoryBudget.
+    // Returns the root the directory is in.
+    DirectoryNode* refreshDirectory(const std::string_view fullPath, const std::span<const std::string> names) {
+        const auto node{ findNode(fullPath) };
+        if (!node || !node->isStale())
+            return nullptr;
+
+        const auto selectedPath{ getSelectedPath() };
+        if (m_memoryBudget) {
+            m_memoryBudget->detach(*node);
+        }
+        node->refreshChildren(names);
+        if (m_memoryBudget) {
+            m_memoryBudget->attach(*node);
+        }
+        ++m_treeGeneration;
+        restoreSelectedPath(selectedPath);
+
+        auto root{ node };
+        while (root->getParent() != m_root) {
+            root = root->getParent();
+        }
+        return root;
+    }
+
+    // Shows the levels of a single root at the top like readFromString does, which
+    // can only be known once every root is read. False if there are other roots.
+    bool flattenSingleRoot() {
+        if (m_root->getChildCount() != 1)
+            return false;
+
+        auto selectedPath{ getSelectedPath() };
+        if (!selectedPath.empty()) {
+            selectedPath.pop_back();
+        }
+        if (m_memoryBudget) {
+            m_memoryBudget->detach(m_root->begin()->second);
+        }
+        m_root->mergeSingleChild();
+        if (m_memoryBudget) {
+            m_memoryBudget->attach(*m_root);
+        }
+        ++m_treeGeneration;
+        restoreSelectedPath(selectedPath);
+        return true;
+    }
+
+    // fullPath as given by getFullPath
+    DirectoryNode* findNode(const std::string_view fullPath) {
+        for (auto& [_, root] : *m_root) {
+            const auto rootPath{ root.getFullPath() };
+            if (!fullPath.starts_with(rootPath))
+                continue;
+
+            DirectoryNode* node{ &root };
+            auto rest{ fullPath.substr(rootPath.length()) };
+            while (!rest.empty()) {
+                const auto separator{ rest.find_first_of('\\') };
+                const auto child{ node->findChild(rest.substr(0, separator)) };
+                if (child == node->end())
+                    return nullptr;
+
+                node = &child->second;
+                rest.remove_prefix(separator == std::string_view::npos ? rest.length() : separator + 1);
+            }
+            return node;
+        }
+        return nullptr;
+    }
+
+    // Called whenever the current node or the selection changes,
+    // so background work can start with what the user is looking at
+    void setFocusListener(FocusListener listener) {
+        m_focusListener = std::move(listener);
+        notifyFocus();
+    }
+
 private:
+    void loadChildren(DirectoryNode* const node) {
+        if (!node->isEvicted())
+            return;
+
+        if (m_memoryBudget) {
+            m_memoryBudget->reload(node, m_fileSystem);
+        } else {
+            node->reloadChildren(m_fileSystem);
+        }
+        ++m_treeGeneration;
+    }
+
+    std::vector<std::string> getSelectedPath() {
+        std::vector<std::string> names{};
+        for (auto node{ getSelectedChild() ? getSelectedChild() : m_currentNode };
+            node != m_root;
+            node = node->getParent()) {
+            names.emplace_back(node->getName());
+        }
+        return names;
+    }
+
+    // Selects the deepest node still there, names are leaf first
+    void restoreSelectedPath(const std::vector<std::string>& names) {
+        DirectoryNode* selected{ m_root };
+        for (auto name{ names.rbegin() }; name != names.rend(); ++name) {
+            const auto child{ selected->findChild(*name) };
+            if (child == selected->end())
+                break;
+
+            selected = &child->second;
+        }
+
+        if (selected == m_root || !focusNode(selected)) {
+            m_currentNode = m_root;
+            m_childIterator = m_root->begin();
+            notifyFocus();
+        }
+    }
+
+    void notifyFocus() {
+        if (m_focusListener) {
+            m_focusListener(*m_currentNode, getSelectedChild());
+        }
+    }
+
+    // selectNode without enforcing the memory budget
+    bool focusNode(DirectoryNode* const node) {
+        const auto parent{ node->getParent() };
+        if (!parent)
+            return false;
+
+        const auto child{ parent->findChild(node->getName()) };
+        if (child == parent->end())
+            return false;
+
+        m_currentNode = parent;
+        m_childIterator = child;
+        touchCurrentNode();
+        return true;
+    }
+
+    void touchCurrentNode() {
+        notifyFocus();
+        if (m_memoryBudget) {
+            m_memoryBudget->touch(m_currentNode);
+        }
+    }
+
+    void visitCurrentNode() {
+        touchCurrentNode();
+        enforceMemoryBudget();
+    }
+
+    DirectoryNode* const m_root;
     DirectoryNode* m_currentNode;
     DirectoryNode::ChildrenMap::iterator m_childIterator{};
+    DirectoryMemoryBudget* const m_memoryBudget;
+    FileSystem& m_fileSystem;
+    FocusListener m_focusListener{};
+    std::uint64_t m_treeGeneration{};
 };
 
@@ -0,0 +1,503 @@
+#include "directory-view.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+void DirectoryView::drawDirectories() const {
+    if (m_search.isActive) {
+        drawSearchResults();
+        return;
+    }
+
+    m_renderBackend.beginFrame();
+
+    TextArea drawableArea{ m_layout.drawableArea };
+    const auto textHeight{ m_navigator->getCurrentNode()->getLongestChildSize().height };
+    const auto selectedChild{ m_navigator->getSelectedChild() };
+    const bool hasFocus{ m_host.hasFocus() };
+    for (const auto& [name, node] : m_navigator->getCurrentNode()->getChildren()) {
+        TextStyle style{};
+        if (hasFocus && selectedChild == &node) {
+            style = node.hasChildren() ? TextStyle::Selected : TextStyle::SelectedLeaf;
+        } else {
+            style = node.isStale() ? TextStyle::Stale : TextStyle::Normal;
+        }
+
+        m_renderBackend.drawText(name, drawableArea, style);
+        drawableArea.top += textHeight;
+    }
+
+    m_renderBackend.endFrame();
+    m_latencyRecorder.markPresented();
+}
+
+void DirectoryView::drawSelectionChange(const DirectoryNode* const previousSelection) const {
+    const auto selectedChild{ m_navigator->getSelectedChild() };
+    if (m_search.isActive || !previousSelection || !m_renderBackend.canRedrawPartially()) {
+        drawDirectories();
+        return;
+    }
+
+    const auto& children{ m_navigator->getCurrentNode()->getChildren() };
+    const auto textHeight{ m_navigator->getCurrentNode()->getLongestChildSize().height };
+
+    // Both rows and everything between them when the selection wrapped around
+    TextArea dirty{ .left{ m_layout.drawableArea.left }, .right{ m_layout.drawableArea.right } };
+    bool isFirstFound{};
+    auto rowTop{ m_layout.drawableArea.top };
+    for (const auto& [_, node] : children) {
+        if (&node == previousSelection || &node == selectedChild) {
+            if (!isFirstFound) {
+                dirty.top = rowTop;
+                isFirstFound = true;
+            }
+            dirty.bottom = rowTop + textHeight;
+        }
+        rowTop += textHeight;
+    }
+    if (!isFirstFound) {
+        drawDirectories();
+        return;
+    }
+
+    m_renderBackend.beginPartialFrame(dirty);
+
+    TextArea drawableArea{ m_layout.drawableArea };
+    const bool hasFocus{ m_host.hasFocus() };
+    for (const auto& [name, node] : children) {
+        if (drawableArea.top >= dirty.bottom)
+            break;
+
+        if (drawableArea.top + textHeight > dirty.top) {
+            TextStyle style{};
+            if (hasFocus && selectedChild == &node) {
+                style = node.hasChildren() ? TextStyle::Selected : TextStyle::SelectedLeaf;
+            } else {
+                style = node.isStale() ? TextStyle::Stale : TextStyle::Normal;
+            }
+            m_renderBackend.drawText(name, drawableArea, style);
+        }
+        drawableArea.top += textHeight;
+    }
+
+    m_renderBackend.endFrame();
+    m_latencyRecorder.markPresented();
+}
+
+void DirectoryView::drawSearchResults() const {
+    m_renderBackend.beginFrame();
+
+    TextArea drawableArea{ m_layout.drawableArea };
+    m_renderBackend.drawText(m_search.queryRow, drawableArea, TextStyle::Normal);
+    drawableArea.top += m_search.rowHeight;
+
+    const bool hasFocus{ m_host.hasFocus() };
+    for (std::size_t i{}; i < m_search.rows.size(); ++i) {
+        const bool isSelected{ hasFocus && i == m_search.selectedRow };
+        m_renderBackend.drawText(
+            m_search.rows[i],
+            drawableArea,
+            isSelected ? TextStyle::Selected : TextStyle::Normal
+        );
+        drawableArea.top += m_search.rowHeight;
+    }
+
+    m_renderBackend.endFrame();
+    m_latencyRecorder.markPresented();
+}
+
+void DirectoryView::cacheNodeSize(DirectoryNode* const node) const {
+    const auto textSize{ m_textMeasurer.measureText(node->getLongestChildName()) };
+    node->setLongestChildSize(textSize.width, std::ceil(textSize.height + m_styleConfig.gaps));
+}
+
+void DirectoryView::fitToContent() {
+    if (m_search.isActive) {
+        fitSearchToContent();
+        return;
+    }
+
+    const auto& currentNode{ m_navigator->getCurrentNode() };
+
+    if (!currentNode->getLongestChildSize().width) {
+        cacheNodeSize(currentNode);
+    }
+
+    const auto longestChildSize{ currentNode->getLongestChildSize() };
+
+    m_layout.width = static_cast<int>(
+        longestChildSize.width + m_styleConfig.padding.horizontal * 2
+    );
+
+    m_layout.height = static_cast<int>(
+        longestChildSize.height * static_cast<float>(currentNode->getChildCount())
+        + m_styleConfig.padding.vertical * 2
+        - m_styleConfig.gaps
+    );
+
+    resizeWindow();
+}
+
+void DirectoryView::fitSearchToContent() {
+    std::string_view longestRow{ m_search.queryRow };
+    for (const auto& row : m_search.rows) {
+        if (row.size() > longestRow.size()) {
+            longestRow = row;
+        }
+    }
+
+    const auto textSize{ m_textMeasurer.measureText(longestRow) };
+    m_search.rowHeight = std::ceil(textSize.height + m_styleConfig.gaps);
+
+    m_layout.width = static_cast<int>(
+        textSize.width + m_styleConfig.padding.horizontal * 2
+    );
+
+    m_layout.height = static_cast<int>(
+        m_search.rowHeight * static_cast<float>(m_search.rows.size() + 1)
+        + m_styleConfig.padding.vertical * 2
+        - m_styleConfig.gaps
+    );
+
+    resizeWindow();
+}
+
+void DirectoryView::resizeWindow() {
+    m_layout.drawableArea = {
+        .left{ m_styleConfig.padding.horizontal },
+        .top{ m_styleConfig.padding.vertical },
+        .right{ static_cast<float>(m_layout.width) - m_styleConfig.padding.horizontal },
+        .bottom{ static_cast<float>(m_layout.height) - m_styleConfig.padding.vertical },
+    };
+
+    m_renderBackend.clear();
+    m_host.resizeWindow(m_layout.width, m_layout.height);
+    m_renderBackend.resize(m_layout.width, m_layout.height);
+}
+
+void DirectoryView::refreshSearch() {
+    m_search.queryRow = searchPrompt;
+    m_search.queryRow += m_search.query;
+    m_search.rows.clear();
+    m_search.entries.clear();
+    m_search.selectedRow = 0;
+
+    if (m_search.query.empty())
+        return;
+
+    for (const auto& result : m_searchIndex->search(m_search.query, maxSearchResults)) {
+        m_search.entries.push_back(result.entry);
+        m_searchIndex->appendFullPath(result.entry, m_search.rows.emplace_back());
+    }
+}
+
+void DirectoryView::setSearchActive(const bool isActive) {
+    m_search.isActive = isActive;
+    m_search.query.clear();
+    refreshSearch();
+    fitToContent();
+    drawDirectories();
+}
+
+void DirectoryView::applyTreeUpdates(TreeLoader::Updates&& updates) {
+    if (updates.roots.empty() && updates.directories.empty() && !updates.isComplete)
+        return;
+
+    // Only the roots changed are indexed again, each once
+    std::vector<std::string> changedRoots{};
+    for (auto& root : updates.roots) {
+        if (!root.replacedName.empty()) {
+            changedRoots.push_back(root.replacedName);
+        }
+        if (const auto node{ m_navigator->replaceRoot(root.replacedName, std::move(root.node)) }) {
+            changedRoots.emplace_back(node->getName());
+        }
+    }
+    for (const auto& directory : updates.directories) {
+        if (const auto root{ m_navigator->refreshDirectory(directory.path, directory.names) }) {
+            changedRoots.emplace_back(root->getName());
+        }
+    }
+    std::sort(changedRoots.begin(), changedRoots.end());
+    changedRoots.erase(std::unique(changedRoots.begin(), changedRoots.end()), changedRoots.end());
+
+    // Indexed before levels are evicted, so they can still be found. Flattening a single
+    // root gives its levels another parent, the whole tree is indexed again then.
+    // Replacing a root can move the selection anywhere, always redraw
+    auto& tree{ *m_navigator->getRoot() };
+    if (updates.isComplete && m_navigator->flattenSingleRoot()) {
+        m_searchIndex->build(tree);
+    } else {
+        for (const auto& name : changedRoots) {
+            if (const auto root{ tree.findChild(name) }; root != tree.end()) {
+                m_searchIndex->updateRoot(root->second);
+            } else {
+                m_searchIndex->removeRoot(name);
+            }
+        }
+    }
+    if (const auto memoryBudget{ m_navigator->getMemoryBudget() }) {
+        memoryBudget->setIndexUsage(m_searchIndex->getMemoryUsage(), m_searchIndex->getEvictedNameBytes());
+    }
+    m_navigator->enforceMemoryBudget();
+    indexBudgetChanges();
+    if (m_search.isActive) {
+        refreshSearch();
+    }
+
+    fitToContent();
+    drawDirectories();
+}
+
+// Builds the index again once levels were evicted or read again, so only what's in the tree
+// has postings. Counting the index again can evict more, which only shrinks it.
+void DirectoryView::indexBudgetChanges() {
+    const auto memoryBudget{ m_navigator->getMemoryBudget() };
+    if (!memoryBudget)
+        return;
+
+    const auto getChanges{ [memoryBudget] {
+        return memoryBudget->getStats().evictions + memoryBudget->getStats().reloads;
+    } };
+    while (m_indexedBudgetChanges != getChanges()) {
+        m_indexedBudgetChanges = getChanges();
+        m_searchIndex->build(*m_navigator->getRoot());
+        memoryBudget->setIndexUsage(m_searchIndex->getMemoryUsage(), m_searchIndex->getEvictedNameBytes());
+        m_navigator->enforceMemoryBudget();
+    }
+}
+
+void DirectoryView::handleSearchKeyPress(
+    const Key key,
+    const InputLatencyRecorder::Clock::time_point inputTime
+) {
+    using Action = InputLatencyRecorder::Action;
+
+    const auto rowCount{ m_search.rows.size() };
+    switch (key) {
+    case Key::Up:
+        if (!rowCount)
+            break;
+
+        m_latencyRecorder.beginInput(Action::Move, inputTime);
+        m_search.selectedRow = (m_search.selectedRow + rowCount - 1) % rowCount;
+        drawDirectories();
+        break;
+    case Key::Down:
+        if (!rowCount)
+            break;
+
+        m_latencyRecorder.beginInput(Action::Move, inputTime);
+        m_search.selectedRow = (m_search.selectedRow + 1) % rowCount;
+        drawDirectories();
+        break;
+    case Key::Backspace:
+        if (m_search.query.empty())
+            break;
+
+        utf8::popBack(m_search.query);
+        refreshSearch();
+        fitToContent();
+        drawDirectories();
+        break;
+    case Key::Return:
+        if (rowCount) {
+            std::array<std::string_view, DirectorySearchIndex::maxDepth> names{};
+            const auto depth{ m_searchIndex->getPathNames(m_search.entries[m_search.selectedRow], names) };
+            if (m_navigator->selectPath({ names.data(), depth })) {
+                m_latencyRecorder.beginInput(Action::Enter, inputTime);
+            }
+        }
+        setSearchActive(false);
+        break;
+    case Key::Tab:
+    case Key::Escape:
+        setSearchActive(false);
+        break;
+    default:
+        break;
+    }
+}
+
+void DirectoryView::handleCharInput(const char32_t character) {
+    if (!m_allocationCounter) {
+        dispatchCharInput(character);
+        return;
+    }
+
+    const auto countsBefore{ AllocationCounter::getThreadCounts() };
+    dispatchCharInput(character);
+
+    auto& allocations{ m_keyAllocations.back() };
+    ++allocations.presses;
+    allocations.counts += AllocationCounter::getThreadCounts() - countsBefore;
+}
+
+void DirectoryView::dispatchCharInput(const char32_t character) {
+    if (!m_search.isActive || character < U' ' || character == 0x7F)
+        return;
+
+    utf8::append(m_search.query, character);
+    refreshSearch();
+    fitToContent();
+    drawDirectories();
+}
+
+void DirectoryView::handleKeyPress(
+    const KeyPress& keyPress,
+    const InputLatencyRecorder::Clock::time_point inputTime
+) {
+    // The index is built again after the frame, any level the key evicted or read counts to the key
+    if (!m_allocationCounter) {
+        dispatchKeyPress(keyPress, inputTime);
+        indexBudgetChanges();
+        return;
+    }
+
+    const auto countsBefore{ AllocationCounter::getThreadCounts() };
+    dispatchKeyPress(keyPress, inputTime);
+    indexBudgetChanges();
+
+    auto& allocations{ m_keyAllocations[static_cast<std::size_t>(keyPress.key)] };
+    ++allocations.presses;
+    allocations.counts += AllocationCounter::getThreadCounts() - countsBefore;
+}
+
+void DirectoryView::dispatchKeyPress(
+    const KeyPress& keyPress,
+    const InputLatencyRecorder::Clock::time_point inputTime
+) {
+    using Action = InputLatencyRecorder::Action;
+
+    if (m_search.isActive) {
+        handleSearchKeyPress(keyPress.key, inputTime);
+        return;
+    }
+
+    // Letters share the actions of the arrows, so both map to one switch
+    auto key{ keyPress.key };
+    if (key == Key::Letter) {
+        switch (keyPress.letter) {
+        case 'a':
+            key = Key::Left;
+            break;
+        case 'd':
+            key = Key::Right;
+            break;
+        case 'w':
+            key = Key::Up;
+            break;
+        case 's':
+            key = Key::Down;
+            break;
+        case 'q':
+            key = Key::Escape;
+            break;
+        default:
+            break;
+        }
+    }
+
+    switch (key) {
+    case Key::Tab:
+        setSearchActive(true);
+        break;
+    case Key::LeftShift:
+    case Key::Left:
+        m_latencyRecorder.beginInput(Action::Parent, inputTime);
+        if (m_navigator->enterParent()) {
+            fitToContent();
+        }
+        drawDirectories();
+        break;
+    case Key::Right:
+        m_latencyRecorder.beginInput(Action::Enter, inputTime);
+        if (m_navigator->enterSelected()) {
+            fitToContent();
+        }
+        drawDirectories();
+        break;
+    case Key::Up: {
+        m_latencyRecorder.beginInput(Action::Move, inputTime);
+        const auto previousSelection{ m_navigator->getSelectedChild() };
+        m_navigator->selectionUp();
+        drawSelectionChange(previousSelection);
+        break;
+    }
+    case Key::Down: {
+        m_latencyRecorder.beginInput(Action::Move, inputTime);
+        const auto previousSelection{ m_navigator->getSelectedChild() };
+        m_navigator->selectionDown();
+        drawSelectionChange(previousSelection);
+        break;
+    }
+    case Key::Return:
+    case Key::Space:
+        if (!m_navigator->getSelectedChild())
+            break;
+
+        m_latencyRecorder.beginInput(Action::Open, inputTime);
+
+        // Without the separator every full path ends with
+        m_openPath.clear();
+        m_navigator->getSelectedChild()->appendFullPath(m_openPath);
+        m_openPath.pop_back();
+        m_host.openExplorer(m_openPath, keyPress.isLeftShiftDown);
+
+        // There is no frame for opening, ShellExecute returning is the closest we get
+        m_latencyRecorder.markPresented();
+        break;
+    case Key::Escape:
+        m_host.close();
+        break;
+    case Key::Letter:
+        if (keyPress.letter == 'e') {
+            m_host.releaseFocus();
+            m_latencyRecorder.beginInput(Action::Open, inputTime);
+            m_openPath.clear();
+            m_navigator->getCurrentNode()->appendFullPath(m_openPath);
+            m_host.openExplorer(m_openPath, keyPress.isLeftShiftDown);
+            m_latencyRecorder.markPresented();
+        } else if (keyPress.letter == 'l') {
+            m_host.writeReport();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void DirectoryView::writeAllocationReport(std::ostream& stream) const {
+    stream << "key\tpresses\tallocations\tdeallocations\tallocated_bytes\n";
+    for (std::size_t i{}; i < m_keyAllocations.size(); ++i) {
+        const auto& allocations{ m_keyAllocations[i] };
+        if (!allocations.presses)
+            continue;
+
+        stream << (i < static_cast<std::size_t>(Key::Count) ? getKeyName(static_cast<Key>(i)) : "char")
+            << '\t' << allocations.presses
+            << '\t' << allocations.counts.allocations
+            << '\t' << allocations.counts.deallocations
+            << '\t' << allocations.counts.allocatedBytes
+            << '\n';
+    }
+}
+
+std::string_view DirectoryView::getKeyName(const Key key) {
+    static constexpr std::array<std::string_view, static_cast<std::size_t>(Key::Count)> names{
+        "up",
+        "down",
+        "left",
+        "right",
+        "return",
+        "space",
+        "tab",
+        "escape",
+        "backspace",
+        "left-shift",
+        "letter",
+    };
+    return names[static_cast<std::size_t>(key)];
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "allocation-counter.h"
+#include "directory-search-index.h"
+#include "directory-utils.h"
+#include "latency-histogram.h"
+#include "render-backend.h"
+#include "tree-loader.h"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What the view needs from the window it is shown in
+class DirectoryViewHost {
+public:
+    virtual ~DirectoryViewHost() = default;
+
+    virtual bool hasFocus() const = 0;
+
+    // Lets the window opened next keep the focus
+    virtual void releaseFocus() = 0;
+
+    // Centered on the screen
+    virtual void resizeWindow(const int width, const int height) = 0;
+
+    virtual void openExplorer(const std::string_view path, const bool keepOpen) = 0;
+
+    virtual void writeReport() = 0;
+
+    virtual void close() = 0;
+};
+
+struct DirectoryViewStyle {
+    struct {
+        float horizontal{ 25 };
+        float vertical{ 15 };
+    } padding{};
+    float gaps{ 5 };
+    float fontSize{ 25 };
+    float backgroundTint{ .4f };
+};
+
+// Navigation, search, layout and drawing of the window without any platform
+// code, so whole sessions can be replayed headless against a fake backend
+class DirectoryView {
+public:
+    using StyleConfig = DirectoryViewStyle;
+
+    enum class Key : std::uint8_t {
+        Up,
+        Down,
+        Left,
+        Right,
+        Return,
+        Space,
+        Tab,
+        Escape,
+        Backspace,
+        LeftShift,
+        Letter,
+        Count,
+    };
+
+    // Letters are lowercase ASCII
+    struct KeyPress {
+        Key key{};
+        char letter{};
+        bool isLeftShiftDown{};
+    };
+
+    DirectoryView(
+        DirectoryNavigator* const navigator,
+        DirectorySearchIndex* const searchIndex,
+        TextMeasurer& textMeasurer,
+        RenderBackend& renderBackend,
+        DirectoryViewHost& host,
+        const StyleConfig styleConfig = {}
+    )
+        : m_styleConfig{ styleConfig }
+        , m_navigator{ navigator }
+        , m_searchIndex{ searchIndex }
+        , m_textMeasurer{ textMeasurer }
+        , m_renderBackend{ renderBackend }
+        , m_host{ host }
+    {
+        if (const auto memoryBudget{ navigator->getMemoryBudget() }) {
+            searchIndex->setEvictedNameLimit(memoryBudget->getEvictedNameLimit());
+        }
+    }
+
+    DirectoryView(DirectoryView&) = delete;
+    DirectoryView(DirectoryView&&) = delete;
+    DirectoryView& operator=(DirectoryView&) = delete;
+
+    void handleKeyPress(const KeyPress& keyPress, const InputLatencyRecorder::Clock::time_point inputTime);
+
+    void handleCharInput(const char32_t character);
+
+    void applyTreeUpdates(TreeLoader::Updates&& updates);
+
+    // Counts what every key press allocates on the calling thread, for writeReport
+    void setAllocationCounter(const AllocationCounter* const counter) {
+        m_allocationCounter = counter;
+    }
+
+    // Fits the window to the current level and draws it
+    void refresh() {
+        fitToContent();
+        drawDirectories();
+    }
+
+    // TODO: could generate one bitmap that is stored in the wrapper
+    // then also add DirectoryNode::m_longestChildWidth to the wrapper
+    void drawDirectories() const;
+
+    // Redraws only the rows of the previous and the current selection where the
+    // backend keeps its last frame, the whole level otherwise
+    void drawSelectionChange(const DirectoryNode* const previousSelection) const;
+
+    void writeReport(std::ostream& stream) const {
+        m_latencyRecorder.writeReport(stream);
+
+        stream << '\n';
+        m_navigator->getRoot()->getStringMemoryStats().writeReport(stream);
+
+        if (const auto memoryBudget{ m_navigator->getMemoryBudget() }) {
+            stream << '\n';
+            memoryBudget->writeReport(stream);
+        }
+
+        if (m_allocationCounter) {
+            stream << '\n';
+            writeAllocationReport(stream);
+        }
+    }
+
+    static std::string_view getKeyName(const Key key);
+
+private:
+    void drawSearchResults() const;
+
+    void cacheNodeSize(DirectoryNode* const node) const;
+
+    void fitToContent();
+
+    void fitSearchToContent();
+
+    void resizeWindow();
+
+    void refreshSearch();
+
+    void indexBudgetChanges();
+
+    void setSearchActive(const bool isActive);
+
+    void handleSearchKeyPress(const Key key, const InputLatencyRecorder::Clock::time_point inputTime);
+
+    void dispatchKeyPress(const KeyPress& keyPress, const InputLatencyRecorder::Clock::time_point inputTime);
+
+    void dispatchCharInput(const char32_t character);
+
+    void writeAllocationReport(std::ostream& stream) const;
+
+    const StyleConfig m_styleConfig{};
+
+    DirectoryNavigator* const m_navigator;
+
+    DirectorySearchIndex* const m_searchIndex;
+
+    TextMeasurer& m_textMeasurer;
+
+    RenderBackend& m_renderBackend;
+
+    DirectoryViewHost& m_host;
+
+    struct {
+        int width{};
+        int height{};
+        TextArea drawableArea{};
+    } m_layout{};
+
+    static constexpr std::string_view searchPrompt{ "Search: " };
+    static constexpr std::size_t maxSearchResults{ 10 };
+
+    struct {
+        bool isActive{};
+        std::string query{};
+        std::string queryRow{};
+        std::vector<std::string> rows{};
+        std::vector<DirectorySearchIndex::EntryId> entries{};
+        std::size_t selectedRow{};
+        float rowHeight{};
+    } m_search{};
+
+    // Evictions and reloads of the memory budget the search index has seen
+    std::uint64_t m_indexedBudgetChanges{};
+
+    // Reused for every path opened, so opening doesn't allocate once it held a long one
+    std::string m_openPath{};
+
+    // Written from drawDirectories once the frame reflecting the input is presented
+    mutable InputLatencyRecorder m_latencyRecorder{};
+
+    struct KeyAllocations {
+        std::uint64_t presses{};
+        AllocationCounter::Counts counts{};
+    };
+
+    const AllocationCounter* m_allocationCounter{};
+
+    // One per key, the last one is for characters typed
+    std::array<KeyAllocations, static_cast<std::size_t>(Key::Count) + 1> m_keyAllocations{};
+};
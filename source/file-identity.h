@@ -0,0 +1,79 @@
+#pragma once
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+// Identifies a directory independently of the path used to reach it,
+// the device and inode on POSIX, the volume serial and file ID on Windows
+struct FileIdentity {
+    std::uint64_t device{};
+    std::uint64_t index{};
+
+    bool operator==(const FileIdentity&) const = default;
+};
+
+struct FileIdentityHash {
+    std::size_t operator()(const FileIdentity& identity) const noexcept {
+        return std::hash<std::uint64_t>{}(identity.index * 31 + identity.device);
+    }
+};
+
+// Links are followed, so a junction and its target share the identity
+inline std::optional<FileIdentity> getFileIdentity(const std::filesystem::path& path) noexcept {
+#ifdef _WIN32
+    const ::HANDLE file{ ::CreateFileW(
+        path.c_str(),
+        0,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS,
+        NULL
+    ) };
+    if (file == INVALID_HANDLE_VALUE)
+        return std::nullopt;
+
+    ::BY_HANDLE_FILE_INFORMATION info{};
+    const ::BOOL result{ ::GetFileInformationByHandle(file, &info) };
+    ::CloseHandle(file);
+    if (!result)
+        return std::nullopt;
+
+    return FileIdentity{
+        .device{ info.dwVolumeSerialNumber },
+        .index{ (static_cast<std::uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow },
+    };
+#else
+    struct ::stat info{};
+    if (::stat(path.c_str(), &info) != 0)
+        return std::nullopt;
+
+    return FileIdentity{
+        .device{ static_cast<std::uint64_t>(info.st_dev) },
+        .index{ static_cast<std::uint64_t>(info.st_ino) },
+    };
+#endif
+}
+
+// Symlinks everywhere and also junctions on Windows
+inline bool isDirectoryLink(const std::filesystem::directory_entry& entry) noexcept {
+    std::error_code error{};
+    const auto status{ entry.symlink_status(error) };
+    if (error)
+        return false;
+
+#ifdef _MSC_VER
+    if (status.type() == std::filesystem::file_type::junction)
+        return true;
+#endif
+    return std::filesystem::is_symlink(status);
+}
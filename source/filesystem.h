@@ -0,0 +1,127 @@
+#pragma once
+
+#include "file-identity.h"
+#include "utf8.h"
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+// Everything the tree builder asks the disk, so slow or fake
+// file systems can be swapped in without touching DirectoryNode.
+// Paths and names are UTF-8, only the real file system converts them.
+class FileSystem {
+public:
+    struct DirectoryEntry {
+        std::string name{};
+        bool isLink{};
+    };
+
+    using DirectoryCallback = std::function<void(const DirectoryEntry&)>;
+
+    virtual ~FileSystem() = default;
+
+    virtual bool exists(const std::string_view path) = 0;
+
+    virtual std::optional<FileIdentity> getIdentity(const std::string_view path) = 0;
+
+    // Calls onDirectory for every subdirectory of path, files are skipped
+    virtual void listDirectories(const std::string_view path, const DirectoryCallback& onDirectory) = 0;
+};
+
+class RealFileSystem : public FileSystem {
+public:
+    bool exists(const std::string_view path) override {
+        std::error_code error{};
+        return std::filesystem::exists(utf8::toPath(path), error);
+    }
+
+    std::optional<FileIdentity> getIdentity(const std::string_view path) override {
+        return getFileIdentity(utf8::toPath(path));
+    }
+
+    void listDirectories(const std::string_view path, const DirectoryCallback& onDirectory) override {
+        std::error_code error{};
+        std::filesystem::directory_iterator dir{ utf8::toPath(path), error };
+        for (; !error && dir != std::filesystem::directory_iterator{}; dir.increment(error)) {
+            if (!dir->is_directory(error))
+                continue;
+
+            onDirectory({
+                .name{ utf8::fromPath(dir->path().filename()) },
+                .isLink{ isDirectoryLink(*dir) },
+            });
+        }
+    }
+};
+
+// Never destroyed, loads stuck on a slow drive may still use it during exit
+inline FileSystem& getRealFileSystem() {
+    static auto* const fileSystem{ new RealFileSystem{} };
+    return *fileSystem;
+}
+
+// Answers every path as an existing empty directory without touching the disk,
+// reading entries with it gives the shape of the config alone
+class SkeletonFileSystem : public FileSystem {
+public:
+    bool exists(const std::string_view) override {
+        return true;
+    }
+
+    std::optional<FileIdentity> getIdentity(const std::string_view) override {
+        return std::nullopt;
+    }
+
+    void listDirectories(const std::string_view, const DirectoryCallback&) override {}
+};
+
+// Delays every operation of another file system, stands in for
+// spun down drives and network shares when testing deadlines
+class DelayedFileSystem : public FileSystem {
+public:
+    struct Delays {
+        std::chrono::microseconds exists{};
+        std::chrono::microseconds identity{};
+        std::chrono::microseconds listing{};
+    };
+
+    DelayedFileSystem(FileSystem& fileSystem, const Delays delays)
+        : m_fileSystem{ fileSystem }
+        , m_delays{ delays }
+    {}
+
+    DelayedFileSystem(FileSystem& fileSystem, const std::chrono::microseconds delay)
+        : DelayedFileSystem{ fileSystem, Delays{ delay, delay, delay } }
+    {}
+
+    bool exists(const std::string_view path) override {
+        wait(m_delays.exists);
+        return m_fileSystem.exists(path);
+    }
+
+    std::optional<FileIdentity> getIdentity(const std::string_view path) override {
+        wait(m_delays.identity);
+        return m_fileSystem.getIdentity(path);
+    }
+
+    void listDirectories(const std::string_view path, const DirectoryCallback& onDirectory) override {
+        wait(m_delays.listing);
+        m_fileSystem.listDirectories(path, onDirectory);
+    }
+
+private:
+    static void wait(const std::chrono::microseconds delay) {
+        if (delay.count()) {
+            std::this_thread::sleep_for(delay);
+        }
+    }
+
+    FileSystem& m_fileSystem;
+    const Delays m_delays;
+};
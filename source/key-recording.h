@@ -0,0 +1,88 @@
+#pragma once
+
+#include "directory-view.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Input given to DirectoryView in order, one event per line:
+// key <key> <letter code> <left shift down> or char <code point>.
+// Written by the window and replayed by tools/replay-harness.
+class KeyRecording {
+public:
+    struct Event {
+        enum class Type : std::uint8_t {
+            Key,
+            Char,
+        };
+
+        Type type{};
+        DirectoryView::KeyPress keyPress{};
+        char32_t character{};
+    };
+
+    void recordKeyPress(const DirectoryView::KeyPress& keyPress) {
+        m_events.push_back({ .type{ Event::Type::Key }, .keyPress{ keyPress } });
+    }
+
+    void recordCharInput(const char32_t character) {
+        m_events.push_back({ .type{ Event::Type::Char }, .character{ character } });
+    }
+
+    const std::vector<Event>& getEvents() const {
+        return m_events;
+    }
+
+    void write(std::ostream& stream) const {
+        for (const auto& event : m_events) {
+            if (event.type == Event::Type::Char) {
+                stream << "char " << static_cast<std::uint32_t>(event.character) << '\n';
+                continue;
+            }
+
+            stream << "key "
+                << static_cast<std::uint32_t>(event.keyPress.key)
+                << ' ' << static_cast<std::uint32_t>(event.keyPress.letter)
+                << ' ' << event.keyPress.isLeftShiftDown
+                << '\n';
+        }
+    }
+
+    // Stops at the first malformed line
+    static KeyRecording read(std::istream& stream) {
+        KeyRecording recording{};
+
+        std::string type{};
+        while (stream >> type) {
+            if (type == "char") {
+                std::uint32_t character{};
+                if (!(stream >> character))
+                    break;
+
+                recording.recordCharInput(static_cast<char32_t>(character));
+                continue;
+            }
+
+            std::uint32_t key{};
+            std::uint32_t letter{};
+            bool isLeftShiftDown{};
+            if (type != "key"
+                || !(stream >> key >> letter >> isLeftShiftDown)
+                || key >= static_cast<std::uint32_t>(DirectoryView::Key::Count))
+                break;
+
+            recording.recordKeyPress({
+                .key{ static_cast<DirectoryView::Key>(key) },
+                .letter{ static_cast<char>(letter) },
+                .isLeftShiftDown{ isLeftShiftDown },
+            });
+        }
+        return recording;
+    }
+
+private:
+    std::vector<Event> m_events{};
+};
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Log-linear histogram of latencies with microsecond resolution.
+// Every power of two is split into 8 buckets, so a reported percentile
+// is never more than 12.5% above the real value.
+class LatencyHistogram {
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    void record(const Duration latency) noexcept {
+        const auto micros{ std::chrono::duration_cast<std::chrono::microseconds>(latency).count() };
+        const auto value{ static_cast<std::uint64_t>(micros > 0 ? micros : 0) };
+
+        ++m_buckets[bucketIndex(value)];
+        ++m_count;
+        if (value > m_max) {
+            m_max = value;
+        }
+    }
+
+    void reset() noexcept {
+        m_buckets.fill(0);
+        m_count = 0;
+        m_max = 0;
+    }
+
+    std::uint64_t getCount() const noexcept {
+        return m_count;
+    }
+
+    Duration getMax() const noexcept {
+        return std::chrono::microseconds{ m_max };
+    }
+
+    // percentile in range <0, 100>
+    Duration getPercentile(const double percentile) const noexcept {
+        if (!m_count)
+            return Duration::zero();
+
+        auto rank{ static_cast<std::uint64_t>(static_cast<double>(m_count) * percentile / 100.0 + 0.5) };
+        if (rank < 1) {
+            rank = 1;
+        }
+
+        std::uint64_t seen{};
+        for (std::size_t i{}; i < bucketCount; ++i) {
+            seen += m_buckets[i];
+            if (seen >= rank) {
+                const auto upperBound{ bucketUpperBound(i) };
+                return std::chrono::microseconds{ upperBound < m_max ? upperBound : m_max };
+            }
+        }
+        return getMax();
+    }
+
+private:
+    static constexpr std::uint64_t subBucketBits{ 3 };
+    static constexpr std::uint64_t subBucketCount{ 1 << subBucketBits };
+    static constexpr std::uint64_t maxExponent{ 40 };
+    static constexpr std::size_t bucketCount{ (maxExponent - subBucketBits + 2) * subBucketCount };
+
+    static std::size_t bucketIndex(const std::uint64_t value) noexcept {
+        if (value < subBucketCount)
+            return static_cast<std::size_t>(value);
+
+        auto exponent{ static_cast<std::uint64_t>(std::bit_width(value)) - 1 };
+        if (exponent > maxExponent)
+            return bucketCount - 1;
+
+        const auto mantissa{ (value >> (exponent - subBucketBits)) & (subBucketCount - 1) };
+        return static_cast<std::size_t>((exponent - subBucketBits + 1) * subBucketCount + mantissa);
+    }
+
+    static std::uint64_t bucketUpperBound(const std::size_t index) noexcept {
+        if (index < subBucketCount)
+            return index;
+
+        const auto exponent{ index / subBucketCount + subBucketBits - 1 };
+        const auto mantissa{ index % subBucketCount };
+        const auto shift{ exponent - subBucketBits };
+        return ((subBucketCount + mantissa + 1) << shift) - 1;
+    }
+
+    std::array<std::uint64_t, bucketCount> m_buckets{};
+    std::uint64_t m_count{};
+    std::uint64_t m_max{};
+};
+
+// Measures the time between an input arriving and the frame
+// that reflects it being presented. Only one input can be in flight,
+// a new one replaces the previous if it was never presented.
+class InputLatencyRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Action {
+        Move,
+        Enter,
+        Parent,
+        Open,
+        Count,
+    };
+
+    void beginInput(const Action action, const Clock::time_point inputTime) noexcept {
+        m_pendingAction = action;
+        m_pendingInputTime = inputTime;
+        m_hasPendingInput = true;
+    }
+
+    void cancelInput() noexcept {
+        m_hasPendingInput = false;
+    }
+
+    void markPresented(const Clock::time_point presentTime = Clock::now()) noexcept {
+        if (!m_hasPendingInput)
+            return;
+
+        m_histograms[static_cast<std::size_t>(m_pendingAction)].record(presentTime - m_pendingInputTime);
+        m_hasPendingInput = false;
+    }
+
+    const LatencyHistogram& getHistogram(const Action action) const noexcept {
+        return m_histograms[static_cast<std::size_t>(action)];
+    }
+
+    bool isEmpty() const noexcept {
+        for (const auto& histogram : m_histograms) {
+            if (histogram.getCount())
+                return false;
+        }
+        return true;
+    }
+
+    void writeReport(std::ostream& stream) const {
+        stream << "action\tcount\tp50_us\tp95_us\tp99_us\tmax_us\n";
+        for (std::size_t i{}; i < m_histograms.size(); ++i) {
+            const auto& histogram{ m_histograms[i] };
+            const auto toMicros{ [](const LatencyHistogram::Duration duration) {
+                return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+            } };
+
+            stream << getActionName(static_cast<Action>(i))
+                << '\t' << histogram.getCount()
+                << '\t' << toMicros(histogram.getPercentile(50.0))
+                << '\t' << toMicros(histogram.getPercentile(95.0))
+                << '\t' << toMicros(histogram.getPercentile(99.0))
+                << '\t' << toMicros(histogram.getMax())
+                << '\n';
+        }
+    }
+
+    static std::string_view getActionName(const Action action) noexcept {
+        switch (action) {
+        case Action::Move:   return "move";
+        case Action::Enter:  return "enter";
+        case Action::Parent: return "parent";
+        case Action::Open:   return "open";
+        default:             return "unknown";
+        }
+    }
+
+private:
+    std::array<LatencyHistogram, static_cast<std::size_t>(Action::Count)> m_histograms{};
+    Clock::time_point m_pendingInputTime{};
+    Action m_pendingAction{};
+    bool m_hasPendingInput{};
+};
@@ -1,12 +1,22 @@
 #include "win32-font-utils.h"
+#include "allocation-counter.h"
+#include "directory-query-index.h"
+#include "directory-search-index.h"
 #include "directory-select-window.h"
 #include "win32-resource-utils.h"
 #include "win32-window-utils.h"
 #include "directory-utils.h"
 #include "resources.h"
+#include "tree-loader.h"
+#include "key-recording.h"
+#include "utf8.h"
 
+#include <chrono>
 #include <fstream>
-#include <locale>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <string>
 #include <string_view>
 #include <winnt.h>
 
@@ -16,22 +26,81 @@ static inline int exitMessage(const std::wstring_view message) {
 }
 
 int main() {
-    std::wifstream file{ "config.txt" };
-    file.imbue(std::locale{ "en_US.UTF-8" });
-    const std::wstring fileContents{ std::istreambuf_iterator{ file }, {} };
+    // Every allocation is counted in builds with the counter, the startup phase begins here
+    AllocationCounter allocationCounter{};
+
+    std::ifstream file{ "config.txt", std::ios::binary };
+    std::string fileContents{ std::istreambuf_iterator<char>{ file }, {} };
     file.close();
 
-    DirectoryNode root{};
-    if (!root.readFromString(fileContents))
+    // Notepad saves UTF-8 with a byte order mark
+    if (fileContents.starts_with(utf8::byteOrderMark)) {
+        fileContents.erase(0, utf8::byteOrderMark.size());
+    }
+
+    if (fileContents.empty())
         return exitMessage(L"Loading config failed.");
 
-    DirectoryNavigator navigator{ &root };
+    TreeLoader::Options loaderOptions{ .cachePath{ "tree-cache.txt" } };
+    if (const auto deadlineOption{ findConfigOption(fileContents, "root-deadline-ms") }) {
+        const auto deadlineMs{ std::strtoull(std::string{ *deadlineOption }.c_str(), nullptr, 10) };
+        loaderOptions.deadline = std::chrono::milliseconds{ deadlineMs };
+    }
+
+    // Starts reading the drives right away, the window is created while they load
+    TreeLoader treeLoader{ fileContents, loaderOptions };
+
+    // Roots are moved in from the loader's pool, so the top node has to use it as well
+    DirectoryNode root{ "/", nullptr, treeLoader.getAllocator() };
+    DirectorySearchIndex searchIndex{};
+
+    std::optional<DirectoryMemoryBudget> memoryBudget{};
+    if (const auto budgetOption{ findConfigOption(fileContents, "memory-budget-mib") }) {
+        const auto budgetMib{ std::strtoull(std::string{ *budgetOption }.c_str(), nullptr, 10) };
+        memoryBudget.emplace(static_cast<std::size_t>(budgetMib) * 1024 * 1024);
+    }
+
+    DirectoryNavigator navigator{ &root, memoryBudget ? &*memoryBudget : nullptr };
+    navigator.setFocusListener([&treeLoader](DirectoryNode& current, DirectoryNode* const selected) {
+        treeLoader.prioritize(current, selected);
+    });
 
-    DirectorySelectWindow window{ L"Quick Folder", &navigator };
+    // Built once another tool queries the tree, see DirectorySelectWindow::resolveQuery
+    DirectoryQueryIndex queryIndex{};
+
+    DirectorySelectWindow window{ L"Quick Folder", &navigator, &searchIndex, &queryIndex, &treeLoader };
+
+    // For replaying the session with tools/replay-harness
+    const auto recordingPath{ findConfigOption(fileContents, "record-keys") };
+    KeyRecording keyRecording{};
+    if (recordingPath) {
+        window.setKeyRecording(&keyRecording);
+    }
+
+    if constexpr (AllocationCounter::isEnabled) {
+        window.setAllocationCounter(&allocationCounter);
+    }
 
     win32::window::enableBackdropBlur(window.getSystemHandle());
+    allocationCounter.endPhase("startup");
     
-    return window.runMessageLoop();
+    const int exitCode{ window.runMessageLoop() };
+    allocationCounter.endPhase("session");
+
+    std::ofstream reportFile{ DirectorySelectWindow::reportPath };
+    window.writeReport(reportFile);
+    reportFile << '\n';
+    treeLoader.getCanonicalizationStats().writeReport(reportFile);
+    if constexpr (AllocationCounter::isEnabled) {
+        reportFile << '\n';
+        allocationCounter.writeReport(reportFile);
+    }
+
+    if (recordingPath) {
+        std::ofstream recordingFile{ utf8::toPath(*recordingPath) };
+        keyRecording.write(recordingFile);
+    }
+    return exitCode;
 }
 
 int WINAPI WinMain(
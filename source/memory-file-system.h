@@ -0,0 +1,294 @@
+#pragma once
+
+#include "filesystem.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A read-only directory tree held in memory, for building trees of
+// millions of entries without touching the disk. Directories are stored
+// breadth first with the children of each one next to each other and
+// sorted by name, so a path is resolved with a binary search per component.
+// Names are compared exactly unless it's case insensitive like on Windows,
+// and / and \ both separate components.
+class MemoryFileSystem : public FileSystem {
+public:
+    // Resolving the link gives the directory at target
+    struct Link {
+        std::string path{};
+        std::string target{};
+    };
+
+    // Every directory of a level gets fanout children, named prefix-0, prefix-1, ...
+    // or from a word list by a hash of the parent when prefix is empty
+    struct Level {
+        std::size_t fanout{};
+        std::string_view prefix{};
+    };
+
+    // Every prefix of every path exists as well
+    explicit MemoryFileSystem(
+        const std::span<const std::string> paths,
+        const std::span<const Link> links = {},
+        const bool isCaseInsensitive = false
+    )
+        : m_isCaseInsensitive{ isCaseInsensitive }
+    {
+        struct PendingDirectory {
+            std::map<std::string, std::size_t, std::less<>> children{};
+            bool isLink{};
+        };
+        std::vector<PendingDirectory> pending(1);
+
+        const auto insert{ [&](const std::string_view path) {
+            std::size_t directory{};
+            forEachComponent(path, [&](const std::string_view name) {
+                const auto child{ pending[directory].children.find(name) };
+                if (child != pending[directory].children.end()) {
+                    directory = child->second;
+                    return true;
+                }
+
+                pending[directory].children.emplace(std::string{ name }, pending.size());
+                directory = pending.size();
+                pending.emplace_back();
+                return true;
+            });
+            return directory;
+        } };
+
+        for (const auto& path : paths) {
+            insert(path);
+        }
+        for (const auto& link : links) {
+            insert(link.target);
+            pending[insert(link.path)].isLink = true;
+        }
+
+        // Renumbers breadth first, so siblings end up next to each other
+        std::vector<std::size_t> order{ 0 };
+        m_directories.resize(pending.size());
+        for (std::size_t i{}; i < order.size(); ++i) {
+            auto& directory{ m_directories[i] };
+            directory.firstChild = static_cast<std::uint32_t>(order.size());
+            directory.childCount = static_cast<std::uint32_t>(pending[order[i]].children.size());
+            for (const auto& [name, child] : pending[order[i]].children) {
+                auto& childDirectory{ m_directories[order.size()] };
+                childDirectory.nameOffset = static_cast<std::uint32_t>(m_names.size());
+                childDirectory.nameLength = static_cast<std::uint16_t>(name.size());
+                childDirectory.target = static_cast<std::uint32_t>(order.size());
+                childDirectory.isLink = pending[child].isLink;
+                m_names += name;
+                order.push_back(child);
+            }
+        }
+
+        for (const auto& link : links) {
+            const auto directory{ findDirectory(link.path, false) };
+            const auto target{ findDirectory(link.target, true) };
+            if (directory && target) {
+                m_directories[*directory].target = *target;
+            }
+        }
+    }
+
+    // Drives are named A:, B:, ... so there can be up to 26
+    static MemoryFileSystem generate(
+        const std::size_t drives,
+        const std::span<const Level> levels,
+        const std::uint64_t seed = 0
+    ) {
+        MemoryFileSystem fileSystem{};
+        auto& directories{ fileSystem.m_directories };
+
+        std::size_t directoryCount{ 1 + drives };
+        std::size_t levelWidth{ drives };
+        for (const auto& level : levels) {
+            levelWidth *= level.fanout;
+            directoryCount += levelWidth;
+        }
+        directories.reserve(directoryCount);
+        directories.push_back({ .firstChild{ 1 }, .childCount{ static_cast<std::uint32_t>(drives) } });
+
+        std::vector<std::string> names{};
+        for (std::size_t drive{}; drive < drives; ++drive) {
+            names.push_back({ static_cast<char>('A' + drive), ':' });
+        }
+        fileSystem.appendChildren(names);
+
+        std::size_t levelStart{ 1 };
+        for (const auto& level : levels) {
+            const auto levelEnd{ directories.size() };
+            for (auto parent{ levelStart }; parent < levelEnd; ++parent) {
+                auto hash{ seed ^ (parent * 0x9E3779B97F4A7C15ull) };
+                names.clear();
+                for (std::size_t i{}; i < level.fanout; ++i) {
+                    hash = hash * 6364136223846793005ull + 1442695040888963407ull;
+                    auto& name{ names.emplace_back(level.prefix.empty()
+                        ? words[(hash >> 33) % words.size()]
+                        : level.prefix
+                    ) };
+                    name += '-';
+                    name += std::to_string(i);
+                }
+
+                directories[parent].firstChild = static_cast<std::uint32_t>(directories.size());
+                directories[parent].childCount = static_cast<std::uint32_t>(level.fanout);
+                fileSystem.appendChildren(names);
+            }
+            levelStart = levelEnd;
+        }
+
+        return fileSystem;
+    }
+
+    bool exists(const std::string_view path) override {
+        return findDirectory(path, true).has_value();
+    }
+
+    std::optional<FileIdentity> getIdentity(const std::string_view path) override {
+        const auto directory{ findDirectory(path, true) };
+        if (!directory)
+            return std::nullopt;
+
+        return FileIdentity{ .device{ identityDevice }, .index{ *directory } };
+    }
+
+    void listDirectories(const std::string_view path, const DirectoryCallback& onDirectory) override {
+        const auto directory{ findDirectory(path, true) };
+        if (!directory)
+            return;
+
+        DirectoryEntry entry{};
+        for (const auto& child : getChildren(m_directories[*directory])) {
+            entry.name = getName(child);
+            entry.isLink = child.isLink;
+            onDirectory(entry);
+        }
+    }
+
+    std::size_t getDirectoryCount() const {
+        return m_directories.size() - 1;
+    }
+
+    std::size_t getMemoryUsage() const {
+        return sizeof(*this)
+            + m_directories.capacity() * sizeof(Directory)
+            + m_names.capacity();
+    }
+
+private:
+    MemoryFileSystem() = default;
+
+    struct Directory {
+        std::uint32_t nameOffset{};
+        std::uint32_t firstChild{};
+        std::uint32_t childCount{};
+
+        // Itself unless it's a link
+        std::uint32_t target{};
+        std::uint16_t nameLength{};
+        bool isLink{};
+    };
+
+    template<typename Callback>
+    static void forEachComponent(std::string_view path, const Callback& callback) {
+        while (!path.empty()) {
+            const auto separator{ path.find_first_of("\\/") };
+            const auto name{ path.substr(0, separator) };
+            if (!name.empty() && !callback(name))
+                return;
+
+            path.remove_prefix(separator == std::string_view::npos ? path.size() : separator + 1);
+        }
+    }
+
+    std::string_view getName(const Directory& directory) const {
+        return std::string_view{ m_names }.substr(directory.nameOffset, directory.nameLength);
+    }
+
+    std::span<const Directory> getChildren(const Directory& directory) const {
+        return std::span{ m_directories }.subspan(directory.firstChild, directory.childCount);
+    }
+
+    // Links passed on the way are always followed, the last one only if followLastLink
+    std::optional<std::uint32_t> findDirectory(const std::string_view path, const bool followLastLink) const {
+        if (m_directories.empty())
+            return std::nullopt;
+
+        std::uint32_t directory{};
+        bool isFound{ true };
+        forEachComponent(path, [&](const std::string_view name) {
+            const auto children{ getChildren(m_directories[m_directories[directory].target]) };
+            const auto child{ std::lower_bound(children.begin(), children.end(), name,
+                [this](const Directory& child, const std::string_view name) { return getName(child) < name; }
+            ) };
+            isFound = child != children.end() && getName(*child) == name;
+            if (isFound) {
+                directory = static_cast<std::uint32_t>(&*child - m_directories.data());
+            } else if (m_isCaseInsensitive) {
+                const auto variant{ std::find_if(children.begin(), children.end(), [&](const Directory& child) {
+                    return utf8::equalsIgnoringCase(getName(child), name);
+                }) };
+                isFound = variant != children.end();
+                if (isFound) {
+                    directory = static_cast<std::uint32_t>(&*variant - m_directories.data());
+                }
+            }
+            return isFound;
+        });
+
+        if (!isFound || !directory)
+            return std::nullopt;
+
+        return followLastLink ? m_directories[directory].target : directory;
+    }
+
+    // Children of the directory being filled, sorted like the constructor's map
+    void appendChildren(std::vector<std::string>& names) {
+        std::sort(names.begin(), names.end());
+        for (const auto& name : names) {
+            const auto index{ static_cast<std::uint32_t>(m_directories.size()) };
+            m_directories.push_back({
+                .nameOffset{ static_cast<std::uint32_t>(m_names.size()) },
+                .target{ index },
+                .nameLength{ static_cast<std::uint16_t>(name.size()) },
+            });
+            m_names += name;
+        }
+    }
+
+    static constexpr std::uint64_t identityDevice{ std::numeric_limits<std::uint32_t>::max() };
+
+    static constexpr std::array<std::string_view, 16> words{
+        "src",
+        "build",
+        "assets",
+        "docs",
+        "node_modules",
+        "release-notes",
+        "Photos 2019",
+        "backups",
+        "Downloads",
+        "third_party",
+        "experiments",
+        "Visual Studio 2022",
+        "music",
+        "tools",
+        "reports-quarterly",
+        "x",
+    };
+
+    std::vector<Directory> m_directories{};
+    std::string m_names{};
+    bool m_isCaseInsensitive{};
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string_view>
+
+// What a row is drawn as, each backend maps it to its own colors
+enum class TextStyle {
+    Normal,
+    Stale,
+    Selected,
+    SelectedLeaf,
+};
+
+struct TextSize {
+    float width{};
+    float height{};
+};
+
+struct TextArea {
+    float left{};
+    float top{};
+    float right{};
+    float bottom{};
+};
+
+// Text is UTF-8, backends convert it to whatever their platform draws
+class TextMeasurer {
+public:
+    virtual ~TextMeasurer() = default;
+
+    virtual TextSize measureText(const std::string_view text) = 0;
+};
+
+// Everything DirectoryView draws with, frames are cleared to the background
+class RenderBackend {
+public:
+    virtual ~RenderBackend() = default;
+
+    virtual void beginFrame() = 0;
+
+    // Backends keeping the last frame can redraw part of it,
+    // the others draw a whole frame every time
+    virtual bool canRedrawPartially() const {
+        return false;
+    }
+
+    // Like beginFrame, but only dirty is cleared and drawn to
+    virtual void beginPartialFrame([[maybe_unused]] const TextArea& dirty) {
+        beginFrame();
+    }
+
+    virtual void drawText(const std::string_view text, const TextArea& area, const TextStyle style) = 0;
+
+    virtual void endFrame() = 0;
+
+    // An empty frame at the old size, so no frame shows stretched text while resizing
+    virtual void clear() = 0;
+
+    virtual void resize(const int width, const int height) = 0;
+};
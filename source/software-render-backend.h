@@ -0,0 +1,345 @@
+#pragma once
+
+#include "render-backend.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Turns code points into coverage bitmaps for SoftwareRenderBackend,
+// which asks for every code point only once
+class GlyphRasterizer {
+public:
+    // Offsets are from the pen position at the top of the row
+    struct Metrics {
+        float advance{};
+        int width{};
+        int height{};
+        int left{};
+        int top{};
+    };
+
+    virtual ~GlyphRasterizer() = default;
+
+    virtual float getLineHeight() const = 0;
+
+    // Fills coverage with width * height bytes row by row, 0 is empty and 255 covered
+    virtual Metrics rasterize(const char32_t codePoint, std::vector<std::uint8_t>& coverage) = 0;
+};
+
+// Every glyph rasterized so far, packed into rows of 8-bit pages.
+// A page ends before its rows outgrow the 16-bit glyph coordinates.
+class GlyphAtlas {
+public:
+    struct Glyph {
+        std::uint16_t x{};
+        std::uint16_t y{};
+        std::uint16_t width{};
+        std::uint16_t height{};
+        std::int16_t left{};
+        std::int16_t top{};
+        std::uint32_t page{};
+        float advance{};
+    };
+
+    explicit GlyphAtlas(GlyphRasterizer& rasterizer)
+        : m_rasterizer{ rasterizer }
+    {
+        m_asciiGlyphs.fill(noGlyph);
+    }
+
+    const Glyph& getGlyph(const char32_t codePoint) {
+        if (codePoint < m_asciiGlyphs.size()) {
+            auto& index{ m_asciiGlyphs[codePoint] };
+            if (index == noGlyph) {
+                index = addGlyph(codePoint);
+            }
+            return m_glyphs[index];
+        }
+
+        const auto [glyph, isNew] { m_otherGlyphs.try_emplace(codePoint, noGlyph) };
+        if (isNew) {
+            glyph->second = addGlyph(codePoint);
+        }
+        return m_glyphs[glyph->second];
+    }
+
+    std::span<const std::uint8_t> getPixels(const std::uint32_t page) const {
+        return m_pages[page];
+    }
+
+    static constexpr std::size_t getWidth() {
+        return width;
+    }
+
+    std::size_t getPageCount() const {
+        return m_pages.size();
+    }
+
+    std::size_t getGlyphCount() const {
+        return m_glyphs.size();
+    }
+
+    std::size_t getMemoryUsage() const {
+        std::size_t pageBytes{};
+        for (const auto& page : m_pages) {
+            pageBytes += page.capacity();
+        }
+        return pageBytes
+            + m_pages.capacity() * sizeof(m_pages.front())
+            + m_glyphs.capacity() * sizeof(Glyph)
+            + m_otherGlyphs.size() * (sizeof(char32_t) + sizeof(std::uint32_t) + 2 * sizeof(void*));
+    }
+
+private:
+    static constexpr std::size_t width{ 512 };
+    static constexpr std::size_t maxPageHeight{ std::numeric_limits<std::uint16_t>::max() };
+    static constexpr std::uint32_t noGlyph{ std::numeric_limits<std::uint32_t>::max() };
+
+    // Shelf packing, a glyph goes right of the last one or starts the next shelf,
+    // and the next page once the shelf would end past maxPageHeight
+    std::uint32_t addGlyph(const char32_t codePoint) {
+        const auto metrics{ m_rasterizer.rasterize(codePoint, m_coverage) };
+        const auto glyphWidth{ static_cast<std::size_t>(std::clamp(metrics.width, 0, static_cast<int>(width))) };
+        const auto glyphHeight{ static_cast<std::size_t>(std::clamp(metrics.height, 0, static_cast<int>(maxPageHeight))) };
+
+        if (m_shelfX + glyphWidth > width) {
+            m_shelfY += m_shelfHeight;
+            m_shelfX = 0;
+            m_shelfHeight = 0;
+        }
+        if (m_pages.empty() || m_shelfY + glyphHeight > maxPageHeight) {
+            m_pages.emplace_back();
+            m_shelfX = 0;
+            m_shelfY = 0;
+            m_shelfHeight = 0;
+        }
+
+        auto& pixels{ m_pages.back() };
+        if ((m_shelfY + glyphHeight) * width > pixels.size()) {
+            pixels.resize(std::min(
+                std::max(pixels.size() * 2, (m_shelfY + glyphHeight) * width),
+                maxPageHeight * width
+            ));
+        }
+
+        for (std::size_t y{}; y < glyphHeight; ++y) {
+            std::copy_n(
+                m_coverage.data() + y * static_cast<std::size_t>(metrics.width),
+                glyphWidth,
+                pixels.data() + (m_shelfY + y) * width + m_shelfX
+            );
+        }
+
+        // Offsets past 16 bits would put the glyph far outside any window anyway
+        static constexpr int minOffset{ std::numeric_limits<std::int16_t>::min() };
+        static constexpr int maxOffset{ std::numeric_limits<std::int16_t>::max() };
+        m_glyphs.push_back({
+            .x{ static_cast<std::uint16_t>(m_shelfX) },
+            .y{ static_cast<std::uint16_t>(m_shelfY) },
+            .width{ static_cast<std::uint16_t>(glyphWidth) },
+            .height{ static_cast<std::uint16_t>(glyphHeight) },
+            .left{ static_cast<std::int16_t>(std::clamp(metrics.left, minOffset, maxOffset)) },
+            .top{ static_cast<std::int16_t>(std::clamp(metrics.top, minOffset, maxOffset)) },
+            .page{ static_cast<std::uint32_t>(m_pages.size() - 1) },
+            .advance{ metrics.advance },
+        });
+        m_shelfX += glyphWidth + padding;
+        m_shelfHeight = std::max(m_shelfHeight, glyphHeight + padding);
+        return static_cast<std::uint32_t>(m_glyphs.size() - 1);
+    }
+
+    // Keeps sampling of neighbours out of each glyph
+    static constexpr std::size_t padding{ 1 };
+
+    GlyphRasterizer& m_rasterizer;
+    std::vector<Glyph> m_glyphs{};
+    std::array<std::uint32_t, 128> m_asciiGlyphs{};
+    std::unordered_map<char32_t, std::uint32_t> m_otherGlyphs{};
+
+    std::vector<std::vector<std::uint8_t>> m_pages{};
+    std::vector<std::uint8_t> m_coverage{};
+    std::size_t m_shelfX{};
+    std::size_t m_shelfY{};
+    std::size_t m_shelfHeight{};
+};
+
+// Draws into premultiplied 0xAARRGGBB pixels in memory, every glyph is
+// rasterized once into the atlas and text is composed from alpha blits of it.
+// Needs no platform code, so drawing can be measured and compared anywhere.
+// The previous frame is kept, so a partial frame only redraws what changed.
+class SoftwareRenderBackend : public RenderBackend, public TextMeasurer {
+public:
+    SoftwareRenderBackend(GlyphRasterizer& rasterizer, const float backgroundTint)
+        : m_rasterizer{ rasterizer }
+        , m_atlas{ rasterizer }
+        , m_background{ static_cast<std::uint32_t>(std::lround(std::clamp(backgroundTint, 0.f, 1.f) * 255.f)) << 24 }
+    {}
+
+    void beginFrame() override {
+        beginPartialFrame({
+            .right{ static_cast<float>(m_width) },
+            .bottom{ static_cast<float>(m_height) },
+        });
+    }
+
+    bool canRedrawPartially() const override {
+        return true;
+    }
+
+    void beginPartialFrame(const TextArea& dirty) override {
+        m_clip = {
+            .left{ std::clamp(static_cast<int>(std::floor(dirty.left)), 0, m_width) },
+            .top{ std::clamp(static_cast<int>(std::floor(dirty.top)), 0, m_height) },
+            .right{ std::clamp(static_cast<int>(std::ceil(dirty.right)), 0, m_width) },
+            .bottom{ std::clamp(static_cast<int>(std::ceil(dirty.bottom)), 0, m_height) },
+        };
+        for (auto y{ m_clip.top }; y < m_clip.bottom; ++y) {
+            const auto row{ m_pixels.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(m_width) };
+            std::fill(row + m_clip.left, row + m_clip.right, m_background);
+        }
+    }
+
+    // Text isn't wrapped, what doesn't fit between left and right is cut off
+    void drawText(const std::string_view text, const TextArea& area, const TextStyle style) override {
+        const auto color{ getColor(style) };
+        const auto clipLeft{ std::max(m_clip.left, static_cast<int>(std::floor(area.left))) };
+        const auto clipRight{ std::min(m_clip.right, static_cast<int>(std::ceil(area.right))) };
+        const auto top{ static_cast<int>(std::lround(area.top)) };
+        if (top >= m_clip.bottom || top + static_cast<int>(m_rasterizer.getLineHeight()) <= m_clip.top)
+            return;
+
+        auto penX{ area.left };
+        for (std::size_t pos{}; pos < text.size();) {
+            const auto& glyph{ m_atlas.getGlyph(utf8::decode(text, pos)) };
+            const auto x{ static_cast<int>(std::lround(penX)) + glyph.left };
+            if (x >= clipRight)
+                break;
+
+            blitGlyph(glyph, x, top + glyph.top, clipLeft, clipRight, color);
+            penX += glyph.advance;
+        }
+    }
+
+    void endFrame() override {
+        ++m_frameCount;
+    }
+
+    void clear() override {
+        std::fill(m_pixels.begin(), m_pixels.end(), m_background);
+    }
+
+    // Only reallocates when the frame grows past anything it was before
+    void resize(const int width, const int height) override {
+        m_width = std::max(width, 0);
+        m_height = std::max(height, 0);
+        m_pixels.assign(static_cast<std::size_t>(m_width) * static_cast<std::size_t>(m_height), m_background);
+    }
+
+    TextSize measureText(const std::string_view text) override {
+        float width{};
+        for (std::size_t pos{}; pos < text.size();) {
+            width += m_atlas.getGlyph(utf8::decode(text, pos)).advance;
+        }
+        return { .width{ width }, .height{ m_rasterizer.getLineHeight() } };
+    }
+
+    std::span<const std::uint32_t> getPixels() const {
+        return m_pixels;
+    }
+
+    int getWidth() const {
+        return m_width;
+    }
+
+    int getHeight() const {
+        return m_height;
+    }
+
+    std::uint64_t getFrameCount() const {
+        return m_frameCount;
+    }
+
+    const GlyphAtlas& getAtlas() const {
+        return m_atlas;
+    }
+
+private:
+    struct Rect {
+        int left{};
+        int top{};
+        int right{};
+        int bottom{};
+    };
+
+    // The same colors as the Direct2D brushes
+    static std::uint32_t getColor(const TextStyle style) {
+        switch (style) {
+        case TextStyle::Stale:
+            return 0xFF999999;
+        case TextStyle::Selected:
+            return 0xFFFFFF00;
+        case TextStyle::SelectedLeaf:
+            return 0xFFFF8000;
+        default:
+            return 0xFFFFFFFF;
+        }
+    }
+
+    // Source over with an opaque color, each channel is color * coverage + pixel * (1 - coverage)
+    static std::uint32_t blend(const std::uint32_t pixel, const std::uint32_t color, const std::uint32_t coverage) {
+        std::uint32_t result{};
+        for (std::uint32_t shift{}; shift < 32; shift += 8) {
+            const auto source{ (color >> shift) & 0xFF };
+            const auto destination{ (pixel >> shift) & 0xFF };
+            result |= ((source * coverage + destination * (255 - coverage) + 127) / 255) << shift;
+        }
+        return result;
+    }
+
+    void blitGlyph(
+        const GlyphAtlas::Glyph& glyph,
+        const int x,
+        const int y,
+        const int clipLeft,
+        const int clipRight,
+        const std::uint32_t color
+    ) {
+        const auto firstColumn{ std::max(0, clipLeft - x) };
+        const auto lastColumn{ std::min(static_cast<int>(glyph.width), clipRight - x) };
+        const auto firstRow{ std::max(0, m_clip.top - y) };
+        const auto lastRow{ std::min(static_cast<int>(glyph.height), m_clip.bottom - y) };
+
+        const auto atlas{ m_atlas.getPixels(glyph.page) };
+        for (auto row{ firstRow }; row < lastRow; ++row) {
+            const auto coverage{ atlas.data() + (glyph.y + row) * GlyphAtlas::getWidth() + glyph.x };
+            const auto pixels{ m_pixels.data() + static_cast<std::size_t>(y + row) * static_cast<std::size_t>(m_width) };
+            for (auto column{ firstColumn }; column < lastColumn; ++column) {
+                const auto alpha{ coverage[column] };
+                auto& pixel{ pixels[x + column] };
+                if (alpha == 255) {
+                    pixel = color;
+                } else if (alpha) {
+                    pixel = blend(pixel, color, alpha);
+                }
+            }
+        }
+    }
+
+    GlyphRasterizer& m_rasterizer;
+    GlyphAtlas m_atlas;
+    const std::uint32_t m_background{};
+
+    std::vector<std::uint32_t> m_pixels{};
+    int m_width{};
+    int m_height{};
+    Rect m_clip{};
+    std::uint64_t m_frameCount{};
+};
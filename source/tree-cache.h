@@ -0,0 +1,91 @@
+#pragma once
+
+#include "directory-utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Last read state of every root, shown while a root is slower than its deadline.
+// Stored as UTF-8 sections starting with >root name followed by the serialized root.
+class TreeCache {
+public:
+    TreeCache(std::filesystem::path path)
+        : m_path{ std::move(path) }
+    {
+        if (m_path.empty())
+            return;
+
+        std::ifstream file{ m_path, std::ios::binary };
+        const std::string contents{ std::istreambuf_iterator<char>{ file }, {} };
+
+        std::string_view rest{ contents };
+        while (!rest.empty()) {
+            const auto sectionEnd{ rest.find("\n" + std::string{ sectionPrefix }) };
+            const auto section{ rest.substr(0, sectionEnd) };
+            rest.remove_prefix(sectionEnd == std::string_view::npos ? rest.size() : sectionEnd + 1);
+
+            if (!section.starts_with(sectionPrefix))
+                continue;
+
+            const auto nameEnd{ section.find_first_of('\n') };
+            if (nameEnd == std::string_view::npos)
+                continue;
+
+            m_roots.insert_or_assign(
+                std::string{ section.substr(sectionPrefix.size(), nameEnd - sectionPrefix.size()) },
+                std::string{ section.substr(nameEnd + 1) }
+            );
+        }
+    }
+
+    std::optional<DirectoryNode> find(
+        const std::string_view rootName,
+        const DirectoryNode::allocator_type& allocator = {}
+    ) const {
+        const std::lock_guard lock{ m_mutex };
+        const auto root{ m_roots.find(std::string{ rootName }) };
+        if (root == m_roots.end())
+            return std::nullopt;
+
+        return DirectoryNode::deserialize(root->second, allocator);
+    }
+
+    // Rewrites the whole file, roots are stored once per start
+    void store(const std::string_view rootName, const DirectoryNode& node) {
+        std::string serialized{};
+        node.serialize(serialized);
+
+        const std::lock_guard lock{ m_mutex };
+        m_roots.insert_or_assign(std::string{ rootName }, std::move(serialized));
+        if (m_path.empty())
+            return;
+
+        auto temporaryPath{ m_path };
+        temporaryPath += ".tmp";
+        {
+            std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+            for (const auto& [name, root] : m_roots) {
+                file << sectionPrefix << name << '\n' << root;
+            }
+            if (!file)
+                return;
+        }
+
+        std::error_code error{};
+        std::filesystem::rename(temporaryPath, m_path, error);
+    }
+
+private:
+    static constexpr std::string_view sectionPrefix{ ">" };
+
+    const std::filesystem::path m_path{};
+
+    mutable std::mutex m_mutex{};
+    std::map<std::string, std::string> m_roots{};
+};
@@ -0,0 +1,485 @@
+#pragma once
+
+#include "directory-utils.h"
+#include "filesystem.h"
+#include "tree-cache.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct TreeLoaderOptions {
+    std::chrono::milliseconds deadline{ 250 };
+    std::filesystem::path cachePath{};
+};
+
+// Reads the config in the background so the window can be shown before the
+// slowest drive is enumerated. A root is every entry sharing the same first
+// component, e.g. D:, and each is read on its own thread. A root not read
+// within the deadline is shown stale from the cache, or as the bare config
+// entries, and replaced once its read finishes.
+// Within a root, entries near what the user is looking at are read first.
+// Roots never wait for each other, the tree doesn't depend on which reads first.
+class TreeLoader {
+public:
+    using Options = TreeLoaderOptions;
+
+    struct RootEntries {
+        std::string name{};
+        std::vector<std::string> entries{};
+    };
+
+    // A newer read of a root, replacedName is the root it takes the place of
+    struct LoadedRoot {
+        std::string replacedName{};
+        std::optional<DirectoryNode> node{};
+    };
+
+    // A directory of a stale root read ahead of the rest of its root
+    struct ScannedDirectory {
+        std::string path{};
+        std::vector<std::string> names{};
+    };
+
+    // Directories always belong to roots taken in the same or an earlier call
+    struct Updates {
+        std::vector<LoadedRoot> roots{};
+        std::vector<ScannedDirectory> directories{};
+
+        // Every root is read, none is going to be added or replaced anymore
+        bool isComplete{};
+    };
+
+    TreeLoader(
+        const std::string_view contents,
+        Options options = {},
+        FileSystem& fileSystem = getRealFileSystem()
+    )
+        : m_state{ std::make_shared<State>(std::move(options), fileSystem) }
+    {
+        const auto roots{ splitIntoRoots(contents) };
+        m_state->roots.reserve(roots.size());
+        for (const auto& entries : roots) {
+            m_state->roots.push_back({
+                .entries{ entries },
+                .isTaken{ std::vector<bool>(entries.entries.size()) },
+            });
+        }
+        m_state->pendingRoots = roots.size();
+
+        // Stopped and joined on destruction, after the entry each is reading
+        m_rootThreads.reserve(roots.size());
+        for (std::size_t i{}; i < roots.size(); ++i) {
+            m_rootThreads.emplace_back([state = m_state, i](const std::stop_token stopToken) {
+                loadRoot(*state, i, stopToken);
+            });
+        }
+        m_watchdog = std::jthread{ [state = m_state](const std::stop_token stopToken) {
+            watchDeadline(*state, stopToken);
+        } };
+    }
+
+    TreeLoader(TreeLoader&) = delete;
+    TreeLoader(TreeLoader&&) = delete;
+    TreeLoader& operator=(TreeLoader&) = delete;
+
+    // Waits for the entry every root is reading, a root stuck on an
+    // unresponsive drive holds up exit until its read returns
+    ~TreeLoader() {
+        {
+            const std::lock_guard lock{ m_state->mutex };
+            m_state->isStopping = true;
+            m_state->listener = {};
+        }
+        for (auto& thread : m_rootThreads) {
+            thread.request_stop();
+        }
+        m_watchdog.request_stop();
+    }
+
+    // Called from a loading thread whenever a root is ready to be taken and once
+    // every root is read. If updates are waiting when it's set, it's called right away.
+    void setListener(std::function<void()> listener) {
+        bool hasUpdates{};
+        {
+            const std::lock_guard lock{ m_state->mutex };
+            m_state->listener = listener;
+            hasUpdates = !m_state->updates.roots.empty() || m_state->updates.isComplete;
+        }
+        if (hasUpdates && listener) {
+            listener();
+        }
+    }
+
+    // In the order they were read, a stale root comes before its replacement
+    Updates takeUpdates() {
+        const std::lock_guard lock{ m_state->mutex };
+        return std::exchange(m_state->updates, {});
+    }
+
+    // Entries under or above the selection are read next, then those of the
+    // current node, then the rest in config order. Takes effect with the next
+    // entry read, the one being read is finished first.
+    void prioritize(DirectoryNode& current, DirectoryNode* const selected) {
+        if (!m_state->staleRoots.load(std::memory_order_relaxed))
+            return;
+
+        std::vector<std::string> paths{};
+        if (selected) {
+            paths.push_back(selected->getFullPath());
+        }
+        if (current.getParent()) {
+            paths.push_back(current.getFullPath());
+        }
+
+        const std::lock_guard lock{ m_state->mutex };
+        m_state->priorityPaths = std::move(paths);
+        ++m_state->priorityGeneration;
+    }
+
+    // Every root is built in a pool owned by the loader, which takes evicted and
+    // replaced nodes back for reuse. A tree using it has to be destroyed before the
+    // loader, roots taken into a tree with another memory resource are copied.
+    DirectoryNode::allocator_type getAllocator() const {
+        return &m_state->resource;
+    }
+
+    DirectoryNode::CanonicalizationStats getCanonicalizationStats() const {
+        const std::lock_guard lock{ m_state->context.mutex };
+        return m_state->context.stats;
+    }
+
+    // Returns false if some root is still being read after the timeout
+    bool waitUntilFinished(const std::chrono::milliseconds timeout) {
+        std::unique_lock lock{ m_state->mutex };
+        return m_state->condition.wait_for(lock, timeout, [this] { return !m_state->pendingRoots; });
+    }
+
+    // Groups canonicalized entries by their first component in config order
+    static std::vector<RootEntries> splitIntoRoots(std::string_view contents) {
+        std::vector<RootEntries> roots{};
+        std::size_t lineEnd{};
+        while (lineEnd != std::string_view::npos) {
+            lineEnd = contents.find_first_of('\n');
+            const auto line{ contents.substr(0, lineEnd) };
+            contents.remove_prefix(lineEnd + 1);
+
+            if (line.starts_with(DirectoryNode::configOptionPrefix))
+                continue;
+
+            const auto entry{ DirectoryNode::canonicalizePath(line) };
+            if (entry.empty())
+                continue;
+
+            const auto name{ std::string_view{ entry }.substr(0, entry.find_first_of('\\')) };
+            auto root{ std::find_if(roots.begin(), roots.end(), [&](const RootEntries& root) {
+                return root.name == name;
+            }) };
+            if (root == roots.end()) {
+                root = roots.insert(roots.end(), RootEntries{ .name{ std::string{ name } } });
+            }
+
+            root->entries.push_back(entry);
+        }
+        return roots;
+    }
+
+private:
+    enum class RootStatus {
+        Loading,
+        Stale,
+        Done,
+    };
+
+    // Entries are taken from prioritized, best last, then in config order from nextInOrder.
+    // prioritized is refilled once priorityGeneration is behind the state's.
+    struct RootState {
+        RootEntries entries{};
+        std::vector<bool> isTaken{};
+        std::vector<std::size_t> prioritized{};
+        std::size_t priorityGeneration{};
+        std::size_t nextInOrder{};
+        RootStatus status{};
+        std::string shownName{};
+    };
+
+    struct NextEntry {
+        std::size_t index{};
+        bool isPrioritized{};
+    };
+
+    struct State {
+        State(Options options, FileSystem& fileSystem)
+            : options{ std::move(options) }
+            , cache{ this->options.cachePath }
+        {
+            context.fileSystem = &fileSystem;
+        }
+
+        const Options options;
+        const std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+        std::pmr::synchronized_pool_resource resource{};
+        DirectoryNode::BuildContext context{};
+        TreeCache cache;
+
+        std::mutex mutex{};
+        std::condition_variable_any condition{};
+        std::function<void()> listener{};
+        std::vector<RootState> roots{};
+        std::vector<std::string> priorityPaths{};
+        std::size_t priorityGeneration{};
+        Updates updates{};
+        std::size_t pendingRoots{};
+        std::atomic<std::size_t> staleRoots{};
+        bool isStopping{};
+    };
+
+    static void loadRoot(State& state, const std::size_t index, const std::stop_token stopToken) {
+        const auto& entries{ state.roots[index].entries };
+
+        DirectoryNode builder{ "/", nullptr, &state.resource };
+        while (const auto next{ takeNextEntry(state, state.roots[index]) }) {
+            if (stopToken.stop_requested())
+                return;
+
+            const auto& entry{ entries.entries[next->index] };
+            const auto node{ builder.insertEntry(entry, state.context) };
+            if (node && next->isPrioritized && entry.ends_with('*')) {
+                pushScannedDirectory(state, state.roots[index], entry, *node);
+            }
+        }
+
+        auto node{ builder.takeSingleChild() };
+        if (node) {
+            state.cache.store(entries.name, *node);
+        }
+
+        std::function<void()> listener{};
+        {
+            const std::lock_guard lock{ state.mutex };
+            auto& root{ state.roots[index] };
+            const bool wasShown{ root.status == RootStatus::Stale };
+            if (wasShown) {
+                --state.staleRoots;
+            }
+            root.status = RootStatus::Done;
+            --state.pendingRoots;
+
+            if (!state.isStopping && (node || wasShown)) {
+                pushLoadedRoot(state, root, std::move(node));
+                listener = state.listener;
+            }
+
+            // Nothing else is read with the context, only its stats are left to report
+            if (!state.pendingRoots) {
+                state.context.endBuild();
+                if (!state.isStopping) {
+                    state.updates.isComplete = true;
+                    listener = state.listener;
+                }
+            }
+        }
+        state.condition.notify_all();
+        if (listener) {
+            listener();
+        }
+    }
+
+    // Only scores the entries again when the priority paths changed since the last call
+    static std::optional<NextEntry> takeNextEntry(State& state, RootState& root) {
+        const std::lock_guard lock{ state.mutex };
+        if (root.priorityGeneration != state.priorityGeneration) {
+            root.priorityGeneration = state.priorityGeneration;
+            prioritizeEntries(state.priorityPaths, root);
+        }
+
+        while (!root.prioritized.empty()) {
+            const auto index{ root.prioritized.back() };
+            root.prioritized.pop_back();
+            if (!root.isTaken[index]) {
+                root.isTaken[index] = true;
+                return NextEntry{ .index{ index }, .isPrioritized{ true } };
+            }
+        }
+
+        while (root.nextInOrder < root.isTaken.size() && root.isTaken[root.nextInOrder]) {
+            ++root.nextInOrder;
+        }
+        if (root.nextInOrder == root.isTaken.size())
+            return std::nullopt;
+
+        root.isTaken[root.nextInOrder] = true;
+        return NextEntry{ .index{ root.nextInOrder++ } };
+    }
+
+    // Entries left under or above a priority path, the highest score and then the first in config order last
+    static void prioritizeEntries(const std::vector<std::string>& priorityPaths, RootState& root) {
+        root.prioritized.clear();
+        if (priorityPaths.empty())
+            return;
+
+        std::vector<std::pair<std::size_t, std::size_t>> scores{};
+        for (std::size_t i{}; i < root.isTaken.size(); ++i) {
+            if (root.isTaken[i])
+                continue;
+
+            if (const auto score{ getPriorityScore(priorityPaths, root.entries.entries[i]) }) {
+                scores.emplace_back(score, i);
+            }
+        }
+        std::sort(scores.begin(), scores.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first != rhs.first ? lhs.first < rhs.first : lhs.second > rhs.second;
+        });
+        for (const auto& [_, index] : scores) {
+            root.prioritized.push_back(index);
+        }
+    }
+
+    // Length of the most specific priority path the entry is under or above, 0 if none
+    static std::size_t getPriorityScore(const std::vector<std::string>& priorityPaths, std::string_view entry) {
+        if (entry.ends_with('*')) {
+            entry.remove_suffix(1);
+        }
+
+        std::size_t score{};
+        for (const std::string_view path : priorityPaths) {
+            const bool isUnderPath{ matchPrefix(entry, path) != std::string_view::npos };
+            const auto abovePrefix{ matchPrefix(path, entry) };
+            const bool isAbovePath{ abovePrefix != std::string_view::npos
+                && (entry.ends_with('\\') || (abovePrefix < path.length() && path[abovePrefix] == '\\')) };
+            if (isUnderPath || isAbovePath) {
+                score = std::max(score, path.length());
+            }
+        }
+        return score;
+    }
+
+    // Bytes of text spelling prefix, npos if text doesn't start with it.
+    // Names differing only in case are the same where the file system says so.
+    static std::size_t matchPrefix(const std::string_view text, const std::string_view prefix) {
+        if constexpr (DirectoryNode::isFileSystemCaseInsensitive) {
+            return utf8::matchPrefixIgnoringCase(text, prefix);
+        } else {
+            return text.starts_with(prefix) ? prefix.length() : std::string_view::npos;
+        }
+    }
+
+    static void pushScannedDirectory(
+        State& state,
+        RootState& root,
+        const std::string_view entry,
+        const DirectoryNode& node
+    ) {
+        ScannedDirectory directory{ .path{ std::string{ entry.substr(0, entry.length() - 1) } } };
+        for (const auto& [name, _] : node.getChildren()) {
+            directory.names.emplace_back(name);
+        }
+
+        std::function<void()> listener{};
+        {
+            const std::lock_guard lock{ state.mutex };
+            if (root.status != RootStatus::Stale || state.isStopping)
+                return;
+
+            state.updates.directories.push_back(std::move(directory));
+            listener = state.listener;
+        }
+        if (listener) {
+            listener();
+        }
+    }
+
+    // Stale roots are read without the lock, a root finished in the meantime keeps its read
+    static void watchDeadline(State& state, const std::stop_token stopToken) {
+        std::vector<std::size_t> lateRoots{};
+        {
+            std::unique_lock lock{ state.mutex };
+            const auto deadline{ state.start + state.options.deadline };
+            if (state.condition.wait_until(lock, stopToken, deadline, [&] { return !state.pendingRoots; }))
+                return;
+
+            for (std::size_t i{}; i < state.roots.size(); ++i) {
+                if (state.roots[i].status == RootStatus::Loading) {
+                    lateRoots.push_back(i);
+                }
+            }
+        }
+
+        std::vector<std::optional<DirectoryNode>> staleNodes{};
+        staleNodes.reserve(lateRoots.size());
+        for (const auto index : lateRoots) {
+            if (stopToken.stop_requested())
+                return;
+
+            const auto& entries{ state.roots[index].entries };
+            auto& node{ staleNodes.emplace_back(state.cache.find(entries.name, &state.resource)) };
+            if (!node) {
+                node = readSkeleton(entries.entries, &state.resource);
+            }
+            if (node) {
+                node->markStale();
+            }
+        }
+
+        std::function<void()> listener{};
+        {
+            const std::lock_guard lock{ state.mutex };
+            if (state.isStopping)
+                return;
+
+            for (std::size_t i{}; i < lateRoots.size(); ++i) {
+                auto& root{ state.roots[lateRoots[i]] };
+                if (root.status != RootStatus::Loading || !staleNodes[i])
+                    continue;
+
+                root.status = RootStatus::Stale;
+                ++state.staleRoots;
+                pushLoadedRoot(state, root, std::move(staleNodes[i]));
+                listener = state.listener;
+            }
+        }
+        if (listener) {
+            listener();
+        }
+    }
+
+    static std::optional<DirectoryNode> readSkeleton(
+        const std::vector<std::string>& entries,
+        const DirectoryNode::allocator_type& allocator
+    ) {
+        SkeletonFileSystem fileSystem{};
+        DirectoryNode::BuildContext context{ .fileSystem{ &fileSystem } };
+
+        DirectoryNode builder{ "/", nullptr, allocator };
+        for (const auto& entry : entries) {
+            builder.insertEntry(entry, context);
+        }
+        return builder.takeSingleChild();
+    }
+
+    static void pushLoadedRoot(State& state, RootState& root, std::optional<DirectoryNode>&& node) {
+        std::string shownName{ node ? node->getName() : std::string_view{} };
+        state.updates.roots.push_back({
+            .replacedName{ std::exchange(root.shownName, std::move(shownName)) },
+            .node{ std::move(node) },
+        });
+    }
+
+    std::shared_ptr<State> m_state{};
+    std::vector<std::jthread> m_rootThreads{};
+    std::jthread m_watchdog{};
+};
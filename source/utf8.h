@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Names, keys and paths are kept as UTF-8 everywhere in the core.
+// Wide strings only exist at the boundary to the platform,
+// e.g. DirectWrite, ShellExecute and std::filesystem::path on Windows.
+namespace utf8 {
+
+inline constexpr std::string_view byteOrderMark{ "\xEF\xBB\xBF" };
+inline constexpr char32_t replacementCharacter{ 0xFFFD };
+
+inline bool isContinuation(const char byte) noexcept {
+    return (static_cast<unsigned char>(byte) & 0xC0) == 0x80;
+}
+
+// Of the sequence starting with lead, stray continuation bytes count as one
+inline std::size_t getSequenceLength(const char lead) noexcept {
+    const auto byte{ static_cast<unsigned char>(lead) };
+    if (byte < 0xC0)
+        return 1;
+    if (byte < 0xE0)
+        return 2;
+    if (byte < 0xF0)
+        return 3;
+    return 4;
+}
+
+// Decodes the code point starting at pos and moves pos past it,
+// malformed bytes are skipped one at a time as U+FFFD
+inline char32_t decode(const std::string_view text, std::size_t& pos) noexcept {
+    const auto lead{ static_cast<unsigned char>(text[pos]) };
+    const auto length{ getSequenceLength(text[pos]) };
+    if (lead < 0x80) {
+        ++pos;
+        return lead;
+    }
+    if (length == 1 || pos + length > text.size()) {
+        ++pos;
+        return replacementCharacter;
+    }
+
+    char32_t codePoint{ lead & (0x7Fu >> length) };
+    for (std::size_t i{ 1 }; i < length; ++i) {
+        if (!isContinuation(text[pos + i])) {
+            ++pos;
+            return replacementCharacter;
+        }
+        codePoint = codePoint << 6 | (static_cast<unsigned char>(text[pos + i]) & 0x3Fu);
+    }
+    pos += length;
+    return codePoint;
+}
+
+// Writes up to 4 bytes to out, returns how many
+inline std::size_t encode(const char32_t codePoint, char* const out) noexcept {
+    if (codePoint < 0x80) {
+        out[0] = static_cast<char>(codePoint);
+        return 1;
+    }
+    if (codePoint < 0x800) {
+        out[0] = static_cast<char>(0xC0 | codePoint >> 6);
+        out[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if (codePoint < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | codePoint >> 12);
+        out[1] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | codePoint >> 18);
+    out[1] = static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+    out[2] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+inline void append(std::string& text, const char32_t codePoint) {
+    char bytes[4]{};
+    text.append(bytes, encode(codePoint, bytes));
+}
+
+// Removes the last code point, not just its last byte
+inline void popBack(std::string& text) noexcept {
+    while (!text.empty() && isContinuation(text.back())) {
+        text.pop_back();
+    }
+    if (!text.empty()) {
+        text.pop_back();
+    }
+}
+
+inline std::size_t countCodePoints(const std::string_view text) noexcept {
+    std::size_t count{};
+    for (const char byte : text) {
+        count += !isContinuation(byte);
+    }
+    return count;
+}
+
+// Of text as std::wstring, UTF-16 code units on Windows and code points elsewhere
+inline std::size_t getWideLength(const std::string_view text) noexcept {
+    std::size_t length{};
+    for (const char byte : text) {
+        if (isContinuation(byte))
+            continue;
+
+        ++length;
+        if constexpr (sizeof(wchar_t) == 2) {
+            length += static_cast<unsigned char>(byte) >= 0xF0;
+        }
+    }
+    return length;
+}
+
+// Simple case folding of one code point, enough for comparing file names.
+// Covers Latin, Greek, Cyrillic and full-width Latin, other scripts are compared as is.
+// Doesn't go through towlower, which folds only ASCII in the C locale nothing changes.
+inline char32_t foldCodePoint(const char32_t codePoint) noexcept {
+    if (codePoint < 0x80)
+        return codePoint >= U'A' && codePoint <= U'Z' ? codePoint + 0x20 : codePoint;
+
+    const auto isIn{ [codePoint](const char32_t first, const char32_t last) {
+        return codePoint >= first && codePoint <= last;
+    } };
+
+    // Upper case a fixed distance before lower case
+    if ((isIn(0xC0, 0xDE) && codePoint != 0xD7)
+        || (isIn(0x391, 0x3AB) && codePoint != 0x3A2)
+        || isIn(0x410, 0x42F)
+        || isIn(0xFF21, 0xFF3A))
+        return codePoint + 0x20;
+    if (isIn(0x400, 0x40F))
+        return codePoint + 0x50;
+    if (isIn(0x388, 0x38A))
+        return codePoint + 0x25;
+    if (isIn(0x38E, 0x38F))
+        return codePoint + 0x3F;
+
+    // Upper and lower case in turns, upper case on even code points
+    if (isIn(0x100, 0x12F) || isIn(0x132, 0x137) || isIn(0x14A, 0x177)
+        || isIn(0x460, 0x481) || isIn(0x48A, 0x4BF) || isIn(0x4D0, 0x52F)
+        || isIn(0x1E00, 0x1E95) || isIn(0x1EA0, 0x1EFF))
+        return codePoint | 1;
+
+    // The same on odd code points
+    if (isIn(0x139, 0x148) || isIn(0x179, 0x17E) || isIn(0x4C1, 0x4CE))
+        return codePoint + (codePoint & 1);
+
+    switch (codePoint) {
+    case 0xB5:
+        return 0x3BC;
+    case 0x178:
+        return 0xFF;
+    case 0x17F:
+        return U's';
+    case 0x386:
+        return 0x3AC;
+    case 0x38C:
+        return 0x3CC;
+    case 0x3C2:
+        return 0x3C3;
+    case 0x4C0:
+        return 0x4CF;
+    case 0x1E9E:
+        return 0xDF;
+    default:
+        return codePoint;
+    }
+}
+
+inline bool equalsIgnoringCase(const std::string_view lhs, const std::string_view rhs) noexcept {
+    std::size_t lhsPos{};
+    std::size_t rhsPos{};
+    while (lhsPos < lhs.size() && rhsPos < rhs.size()) {
+        if (foldCodePoint(decode(lhs, lhsPos)) != foldCodePoint(decode(rhs, rhsPos)))
+            return false;
+    }
+    return lhsPos == lhs.size() && rhsPos == rhs.size();
+}
+
+// Bytes of text that match prefix ignoring case, npos if text doesn't start with it
+inline std::size_t matchPrefixIgnoringCase(const std::string_view text, const std::string_view prefix) noexcept {
+    std::size_t textPos{};
+    std::size_t prefixPos{};
+    while (prefixPos < prefix.size()) {
+        if (textPos == text.size())
+            return std::string_view::npos;
+        if (foldCodePoint(decode(text, textPos)) != foldCodePoint(decode(prefix, prefixPos)))
+            return std::string_view::npos;
+    }
+    return textPos;
+}
+
+// Reuses the capacity of out, so converting every frame doesn't allocate
+inline void toWide(const std::string_view text, std::wstring& out) {
+    out.clear();
+    for (std::size_t pos{}; pos < text.size();) {
+        const auto codePoint{ decode(text, pos) };
+        if (sizeof(wchar_t) == 2 && codePoint >= 0x10000) {
+            out += static_cast<wchar_t>(0xD800 + ((codePoint - 0x10000) >> 10));
+            out += static_cast<wchar_t>(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+        } else {
+            out += static_cast<wchar_t>(codePoint);
+        }
+    }
+}
+
+inline std::wstring toWide(const std::string_view text) {
+    std::wstring wide{};
+    toWide(text, wide);
+    return wide;
+}
+
+// A narrow string would be read in the ANSI code page on Windows
+inline std::filesystem::path toPath(const std::string_view text) {
+    return std::filesystem::path{
+        std::u8string_view{ reinterpret_cast<const char8_t*>(text.data()), text.size() }
+    };
+}
+
+inline std::string fromPath(const std::filesystem::path& path) {
+    const auto text{ path.u8string() };
+    return std::string{ reinterpret_cast<const char*>(text.data()), text.size() };
+}
+
+}
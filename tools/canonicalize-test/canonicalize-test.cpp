@@ -0,0 +1,238 @@
+// Reads configs against MemoryFileSystem trees with links and checks that
+// entries are canonicalized, that every directory is listed once, that
+// junctions share the listing of the directory they point at and that
+// links back to an ancestor are refused.
+//
+// Build from this directory, on Linux with
+//     g++ -std=c++2b -O2 -I../../source canonicalize-test.cpp -o canonicalize-test
+//
+// Usage: canonicalize-test
+// Prints every failed check and exits with 1 if there was one.
+
+#include "directory-utils.h"
+#include "memory-file-system.h"
+#include "tree-loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    int failures{};
+
+    void check(const bool isPassed, const std::string_view description) {
+        if (!isPassed) {
+            std::printf("failed: %.*s\n", static_cast<int>(description.size()), description.data());
+            ++failures;
+        }
+    }
+
+    // Counts the listings of every directory, by what it is and not by the path it was read through
+    class CountingFileSystem : public FileSystem {
+    public:
+        explicit CountingFileSystem(FileSystem& fileSystem)
+            : m_fileSystem{ fileSystem }
+        {}
+
+        bool exists(const std::string_view path) override {
+            return m_fileSystem.exists(path);
+        }
+
+        std::optional<FileIdentity> getIdentity(const std::string_view path) override {
+            return m_fileSystem.getIdentity(path);
+        }
+
+        void listDirectories(const std::string_view path, const DirectoryCallback& onDirectory) override {
+            if (const auto identity{ m_fileSystem.getIdentity(path) }) {
+                ++m_listings[identity->index];
+            }
+            m_fileSystem.listDirectories(path, onDirectory);
+        }
+
+        std::size_t getListingCount(const std::string_view path) {
+            const auto identity{ m_fileSystem.getIdentity(path) };
+            return identity ? m_listings[identity->index] : 0;
+        }
+
+        std::size_t getMaxListingCount() const {
+            std::size_t count{};
+            for (const auto& [_, listings] : m_listings) {
+                count = std::max(count, listings);
+            }
+            return count;
+        }
+
+    private:
+        FileSystem& m_fileSystem;
+        std::map<std::uint64_t, std::size_t> m_listings{};
+    };
+
+    // Full paths of every node without the trailing separator, flattened names span several components
+    void collectPaths(DirectoryNode& node, std::set<std::string>& paths) {
+        for (auto& [_, child] : node) {
+            auto path{ child.getFullPath() };
+            path.pop_back();
+            paths.insert(path);
+            collectPaths(child, paths);
+        }
+    }
+
+    std::set<std::string> getPaths(DirectoryNode& root) {
+        std::set<std::string> paths{};
+        collectPaths(root, paths);
+        return paths;
+    }
+
+    void checkPaths(const std::set<std::string>& paths, const std::set<std::string>& expected, const std::string_view description) {
+        check(paths == expected, description);
+        if (paths != expected) {
+            for (const auto& path : paths) {
+                std::printf("    %s%s\n", path.c_str(), expected.contains(path) ? "" : "  (unexpected)");
+            }
+            for (const auto& path : expected) {
+                if (!paths.contains(path)) {
+                    std::printf("    %s  (missing)\n", path.c_str());
+                }
+            }
+        }
+    }
+
+    struct ReadResult {
+        std::set<std::string> paths{};
+        DirectoryNode::CanonicalizationStats stats{};
+    };
+
+    ReadResult read(const std::string_view config, FileSystem& fileSystem) {
+        DirectoryNode root{};
+        ReadResult result{};
+        root.readFromString(config, &result.stats, fileSystem);
+        result.paths = getPaths(root);
+        return result;
+    }
+
+    // The same config through the loader, every root on its own thread,
+    // put together the way the window does once every root is read
+    std::set<std::string> load(const std::string_view config, FileSystem& fileSystem) {
+        TreeLoader loader{ config, { .deadline{ std::chrono::hours{ 1 } } }, fileSystem };
+        loader.waitUntilFinished(std::chrono::hours{ 1 });
+
+        DirectoryNode root{};
+        DirectoryNavigator navigator{ &root, nullptr, fileSystem };
+        auto updates{ loader.takeUpdates() };
+        for (auto& loadedRoot : updates.roots) {
+            navigator.replaceRoot(loadedRoot.replacedName, std::move(loadedRoot.node));
+        }
+        check(updates.isComplete, "the loader reports every root read");
+        navigator.flattenSingleRoot();
+        return getPaths(root);
+    }
+}
+
+int main() {
+    // Every config has an entry on B: as well, so A: isn't flattened into the root
+    const std::vector<std::string> paths{
+        "A:\\OBS\\clips",
+        "A:\\OBS\\scenes",
+        "A:\\proj\\src",
+        "A:\\proj\\docs",
+        "A:\\x\\one",
+        "A:\\x\\two",
+        "A:\\z\\far",
+        "B:\\b",
+    };
+    const std::vector<MemoryFileSystem::Link> links{
+        { "A:\\link", "A:\\x" },
+        { "B:\\link", "A:\\x" },
+        { "A:\\x\\loop", "A:\\x" },
+        { "A:\\x\\two\\up", "A:" },
+        { "A:\\x\\side", "A:\\z" },
+    };
+    MemoryFileSystem memoryFileSystem{ paths, links };
+    MemoryFileSystem caseInsensitiveFileSystem{ paths, links, true };
+
+    {
+        CountingFileSystem fileSystem{ memoryFileSystem };
+        const auto result{ read("A:\\proj\\*\na:/proj/\nA:\\proj\\\\*\nA:/proj//*\nB:\\b\n", fileSystem) };
+        checkPaths(result.paths, { "A:\\proj", "A:\\proj\\src", "A:\\proj\\docs", "B:\\b" },
+            "drive letter case and separators end at the same node");
+        check(fileSystem.getListingCount("A:\\proj") == 1, "a directory configured with different separators is listed once");
+        check(result.stats.duplicateEntries == 3, "entries differing in separators are counted as duplicates");
+    }
+
+    {
+        CountingFileSystem fileSystem{ caseInsensitiveFileSystem };
+        const auto result{ read("A:\\OBS\\*\nA:\\obs\\*\nB:\\b\n", fileSystem) };
+        check(fileSystem.getListingCount("A:\\OBS") == 1, "a directory configured in two cases is listed once");
+        if constexpr (DirectoryNode::isFileSystemCaseInsensitive) {
+            checkPaths(result.paths, { "A:\\OBS", "A:\\OBS\\clips", "A:\\OBS\\scenes", "B:\\b" },
+                "case variants end at the same node");
+            check(result.stats.duplicateEntries == 1, "a case variant is counted as a duplicate");
+        } else {
+            // Names differing in case are different nodes where file systems usually tell them apart
+            checkPaths(result.paths, {
+                "A:", "A:\\OBS", "A:\\OBS\\clips", "A:\\OBS\\scenes",
+                "A:\\obs", "A:\\obs\\clips", "A:\\obs\\scenes",
+                "B:\\b",
+            }, "case variants share the listing under their own names");
+            check(result.stats.sharedEnumerations == 1, "a case variant shares the listing");
+        }
+    }
+
+    const std::set<std::string> junctionPaths{
+        "A:", "A:\\x", "A:\\x\\one", "A:\\x\\two", "A:\\x\\side",
+        "A:\\link", "A:\\link\\one", "A:\\link\\two", "A:\\link\\side",
+        "B:\\link", "B:\\link\\one", "B:\\link\\two", "B:\\link\\side",
+    };
+    for (const auto config : {
+        "A:\\x\\*\nA:\\link\\*\nB:\\link\\*\n",
+        "B:\\link\\*\nA:\\link\\*\nA:\\x\\*\n",
+    }) {
+        CountingFileSystem fileSystem{ memoryFileSystem };
+        const auto result{ read(config, fileSystem) };
+        checkPaths(result.paths, junctionPaths, "junctions into a configured directory keep their own names");
+        check(fileSystem.getListingCount("A:\\x") == 1, "a directory reached through junctions is listed once");
+        check(result.stats.sharedEnumerations == 2, "both junctions share the listing");
+        check(result.stats.duplicateEntries == 0, "a junction isn't a duplicate");
+        check(result.stats.refusedCycles == 1, "the loop inside the directory is refused once");
+
+        checkPaths(load(config, memoryFileSystem), junctionPaths, "the loader gives junctions the same children");
+    }
+
+    {
+        CountingFileSystem fileSystem{ memoryFileSystem };
+        const auto result{ read("A:\\x\\*\nA:\\x\\two\\*\nB:\\b\n", fileSystem) };
+        checkPaths(result.paths, {
+            "A:\\x", "A:\\x\\one", "A:\\x\\two", "A:\\x\\side", "B:\\b",
+        }, "links to the directory itself and to an ancestor are left out, others are kept");
+        check(result.stats.refusedCycles == 2, "links to the directory and to an ancestor are refused");
+        check(fileSystem.getMaxListingCount() == 1, "nothing is listed twice");
+    }
+
+    {
+        CountingFileSystem fileSystem{ memoryFileSystem };
+        const auto result{ read("A:\\x\\loop\\*\nB:\\b\n", fileSystem) };
+        checkPaths(result.paths, {
+            "A:\\x\\loop", "A:\\x\\loop\\one", "A:\\x\\loop\\two", "A:\\x\\loop\\side", "B:\\b",
+        }, "an entry through a link to its parent lists the parent once, without itself");
+        check(result.stats.refusedCycles == 1, "the link back is refused inside the entry");
+    }
+
+    {
+        // Full paths keep the drive flattened into the top node
+        const std::string_view config{ "A:\\x\\*\nA:\\OBS\\*\n" };
+        const std::set<std::string> singleDrivePaths{
+            "A:\\x", "A:\\x\\one", "A:\\x\\two", "A:\\x\\side", "A:\\OBS", "A:\\OBS\\clips", "A:\\OBS\\scenes",
+        };
+        checkPaths(read(config, memoryFileSystem).paths, singleDrivePaths, "a single drive is flattened into the top node");
+        checkPaths(load(config, memoryFileSystem), singleDrivePaths, "the loader flattens a single drive once every root is read");
+    }
+
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+// Feeds known latencies to LatencyHistogram and InputLatencyRecorder and
+// checks the bucket edges, the percentiles and the split by action.
+//
+// Build from this directory, on Linux with
+//     g++ -std=c++2b -O2 -I../../source latency-histogram-test.cpp -o latency-histogram-test
+//
+// Usage: latency-histogram-test
+// Prints every failed check and exits with 1 if there was one.
+
+#include "latency-histogram.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+namespace {
+    using std::chrono::microseconds;
+    using Action = InputLatencyRecorder::Action;
+
+    int failures{};
+
+    void check(const bool isPassed, const char* const description) {
+        if (!isPassed) {
+            std::printf("failed: %s\n", description);
+            ++failures;
+        }
+    }
+
+    std::int64_t toMicros(const LatencyHistogram::Duration duration) {
+        return std::chrono::duration_cast<microseconds>(duration).count();
+    }
+
+    // The percentile a histogram holding value alone reports, that's the upper edge of its bucket
+    std::int64_t getBucketEdge(const std::int64_t value) {
+        LatencyHistogram histogram{};
+        histogram.record(microseconds{ value });
+        histogram.record(microseconds{ 1'000'000'000 });
+        return toMicros(histogram.getPercentile(50.0));
+    }
+}
+
+int main() {
+    {
+        const LatencyHistogram histogram{};
+        check(histogram.getCount() == 0, "an empty histogram counts nothing");
+        check(toMicros(histogram.getPercentile(99.0)) == 0, "an empty histogram reports 0");
+    }
+
+    // Below 16 us every microsecond has its own bucket, above that 8 buckets per power of two
+    check(getBucketEdge(0) == 0, "0 us is its own bucket");
+    check(getBucketEdge(7) == 7, "7 us is its own bucket");
+    check(getBucketEdge(15) == 15, "15 us is its own bucket");
+    check(getBucketEdge(16) == 17, "16 us shares a bucket up to 17 us");
+    check(getBucketEdge(17) == 17, "17 us ends its bucket");
+    check(getBucketEdge(18) == 19, "18 us starts the next bucket");
+    check(getBucketEdge(1000) == 1023, "1000 us is in the bucket ending at 1023 us");
+    check(getBucketEdge(1023) == 1023, "1023 us ends its bucket");
+    check(getBucketEdge(1024) == 1151, "1024 us starts a bucket of 128 us");
+
+    // Every reported percentile is at most 12.5% above the value at that rank
+    bool isWithinError{ true };
+    for (std::int64_t value{ 1 }; value < 5'000'000; value = value * 3 / 2 + 1) {
+        const auto edge{ getBucketEdge(value) };
+        isWithinError &= edge >= value && edge * 8 <= value * 9;
+    }
+    check(isWithinError, "bucket edges are within 12.5% above the value");
+
+    {
+        LatencyHistogram histogram{};
+        for (std::int64_t value{ 1 }; value <= 100; ++value) {
+            histogram.record(microseconds{ value });
+        }
+        check(histogram.getCount() == 100, "1..100 us counts 100");
+        check(toMicros(histogram.getPercentile(50.0)) == 51, "p50 of 1..100 us is the bucket of 50 us");
+        check(toMicros(histogram.getPercentile(95.0)) == 95, "p95 of 1..100 us is the bucket of 95 us");
+        check(toMicros(histogram.getPercentile(99.0)) == 100, "p99 of 1..100 us is capped at the max");
+        check(toMicros(histogram.getMax()) == 100, "the max is exact");
+
+        histogram.reset();
+        check(histogram.getCount() == 0 && toMicros(histogram.getMax()) == 0, "reset empties the histogram");
+    }
+
+    {
+        LatencyHistogram histogram{};
+        histogram.record(std::chrono::nanoseconds{ -5'000 });
+        histogram.record(std::chrono::nanoseconds{ 999 });
+        check(histogram.getCount() == 2, "negative and sub-microsecond latencies are counted");
+        check(toMicros(histogram.getPercentile(100.0)) == 0, "they are recorded as 0 us");
+    }
+
+    {
+        InputLatencyRecorder recorder{};
+        check(recorder.isEmpty(), "a new recorder is empty");
+
+        const auto start{ InputLatencyRecorder::Clock::now() };
+        recorder.markPresented(start);
+        check(recorder.isEmpty(), "presenting without an input records nothing");
+
+        recorder.beginInput(Action::Move, start);
+        recorder.markPresented(start + microseconds{ 2000 });
+        recorder.beginInput(Action::Move, start);
+        recorder.markPresented(start + microseconds{ 300 });
+        recorder.markPresented(start + microseconds{ 900 });
+
+        recorder.beginInput(Action::Enter, start);
+        recorder.beginInput(Action::Parent, start);
+        recorder.markPresented(start + microseconds{ 50 });
+
+        recorder.beginInput(Action::Open, start);
+        recorder.cancelInput();
+        recorder.markPresented(start + microseconds{ 70 });
+
+        const auto& move{ recorder.getHistogram(Action::Move) };
+        check(move.getCount() == 2, "moves are recorded once per input");
+        check(toMicros(move.getPercentile(50.0)) == 319, "p50 of moves is the bucket of 300 us");
+        check(toMicros(move.getPercentile(99.0)) == 2000, "p99 of moves is the slower one, capped at the max");
+        check(recorder.getHistogram(Action::Enter).getCount() == 0, "an input replaced before presenting isn't recorded");
+        check(recorder.getHistogram(Action::Parent).getCount() == 1, "the replacing input is recorded");
+        check(toMicros(recorder.getHistogram(Action::Parent).getMax()) == 50, "the replacing input is timed");
+        check(recorder.getHistogram(Action::Open).getCount() == 0, "a cancelled input isn't recorded");
+
+        std::stringstream report{};
+        recorder.writeReport(report);
+        std::string header{};
+        std::string moveRow{};
+        std::getline(report, header);
+        std::getline(report, moveRow);
+        check(header == "action\tcount\tp50_us\tp95_us\tp99_us\tmax_us", "the report has a header");
+        check(moveRow == "move\t2\t319\t2000\t2000\t2000", "the report has a row per action");
+    }
+
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+// Resolves batches of paths against a large generated tree with DirectoryQueryIndex
+// and, for comparison, with DirectoryNavigator::findNode. Checks that every path the
+// index gives back is found by findNode and that removing a root makes it stale.
+//
+// Build from this directory, on Linux with
+//     g++ -std=c++2b -O2 -I../../source query-benchmark.cpp -o query-benchmark
+//
+// Usage: query-benchmark [--drives N] [--areas N] [--projects N] [--fanout N] [--queries N]
+// Queries are a fixed mix of node paths, paths of files below nodes and paths outside the tree.
+
+#include "directory-query-index.h"
+#include "directory-utils.h"
+#include "memory-file-system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::size_t drives{ 3 };
+        std::size_t areas{ 100 };
+        std::size_t projects{ 100 };
+        std::size_t fanout{ 34 };
+        std::size_t queries{ 100'000 };
+    };
+
+    bool parseOptions(const int argc, char** const argv, Options& options) {
+        for (int i{ 1 }; i + 1 < argc; i += 2) {
+            const std::string_view argument{ argv[i] };
+            const auto value{ static_cast<std::size_t>(std::strtoull(argv[i + 1], nullptr, 10)) };
+            if (argument == "--drives") {
+                options.drives = std::clamp<std::size_t>(value, 1, 26);
+            } else if (argument == "--areas") {
+                options.areas = value;
+            } else if (argument == "--projects") {
+                options.projects = value;
+            } else if (argument == "--fanout") {
+                options.fanout = value;
+            } else if (argument == "--queries") {
+                options.queries = value;
+            } else {
+                return false;
+            }
+        }
+        return argc % 2 == 1;
+    }
+
+    // Drive\area\project\* for every combination, the same shape as the replay harness
+    std::string generateConfig(const Options& options) {
+        std::string config{};
+        for (std::size_t drive{}; drive < options.drives; ++drive) {
+            for (std::size_t area{}; area < options.areas; ++area) {
+                for (std::size_t project{}; project < options.projects; ++project) {
+                    config += static_cast<char>('A' + drive);
+                    config += ":\\area-" + std::to_string(area);
+                    config += "\\project-" + std::to_string(project) + "\\*\n";
+                }
+            }
+        }
+        return config;
+    }
+
+    void collectNodes(DirectoryNode& node, std::vector<DirectoryNode*>& nodes) {
+        for (auto& [_, child] : node) {
+            nodes.push_back(&child);
+            collectNodes(child, nodes);
+        }
+    }
+
+    double toMilliseconds(const std::chrono::steady_clock::duration time) {
+        return std::chrono::duration<double, std::milli>{ time }.count();
+    }
+}
+
+int main(const int argc, char** const argv) {
+    Options options{};
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: query-benchmark [--drives N] [--areas N] [--projects N] [--fanout N] [--queries N]\n";
+        return 1;
+    }
+
+    const MemoryFileSystem::Level levels[]{
+        { .fanout{ options.areas }, .prefix{ "area" } },
+        { .fanout{ options.projects }, .prefix{ "project" } },
+        { .fanout{ options.fanout } },
+    };
+    auto fileSystem{ MemoryFileSystem::generate(options.drives, levels) };
+
+    DirectoryNode root{};
+    root.readFromString(generateConfig(options), nullptr, fileSystem);
+    DirectoryNavigator navigator{ &root, nullptr, fileSystem };
+
+    const auto buildStart{ std::chrono::steady_clock::now() };
+    DirectoryQueryIndex index{};
+    index.update(root, navigator.getTreeGeneration());
+    const auto buildTime{ std::chrono::steady_clock::now() - buildStart };
+
+    std::vector<DirectoryNode*> nodes{};
+    collectNodes(root, nodes);
+
+    // Half node paths, a third files below nodes, the rest outside the tree
+    std::vector<std::string> paths{};
+    paths.reserve(options.queries);
+    std::uint64_t state{ 0x9E3779B97F4A7C15ull };
+    for (std::size_t i{}; i < options.queries; ++i) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const auto roll{ (state >> 33) % 6 };
+        auto path{ nodes[(state >> 13) % nodes.size()]->getFullPath() };
+        if (roll < 3) {
+            path.pop_back();
+        } else if (roll < 5) {
+            path += "notes\\2024\\todo.txt";
+        } else {
+            path.insert(0, "Z:\\elsewhere\\");
+        }
+        paths.push_back(std::move(path));
+    }
+    const std::vector<std::string_view> pathViews(paths.begin(), paths.end());
+
+    std::vector<DirectoryQueryIndex::Resolution> results(pathViews.size());
+    const auto resolveStart{ std::chrono::steady_clock::now() };
+    index.resolve(pathViews, results);
+    const auto resolveTime{ std::chrono::steady_clock::now() - resolveStart };
+
+    std::size_t exact{};
+    std::size_t covered{};
+    for (const auto& result : results) {
+        exact += result.isExact;
+        covered += result.entry != DirectoryQueryIndex::noEntry;
+    }
+
+    // findNode only answers exact paths, so it gets the node paths alone
+    std::size_t found{};
+    std::size_t nodeQueries{};
+    const auto findStart{ std::chrono::steady_clock::now() };
+    for (const auto path : pathViews) {
+        if (path.starts_with("Z:") || path.ends_with(".txt"))
+            continue;
+
+        ++nodeQueries;
+        found += navigator.findNode(std::string{ path } + '\\') != nullptr;
+    }
+    const auto findTime{ std::chrono::steady_clock::now() - findStart };
+
+    std::size_t pathsFound{};
+    std::string fullPath{};
+    for (const auto& result : results) {
+        if (result.entry == DirectoryQueryIndex::noEntry)
+            continue;
+
+        fullPath.clear();
+        index.appendFullPath(result.entry, fullPath);
+        pathsFound += navigator.findNode(fullPath) != nullptr;
+    }
+
+    const auto componentCount{ index.getComponentCount() };
+    const auto indexBytes{ index.getMemoryUsage() };
+
+    // Nothing below a removed root may be covered once the index is updated
+    const auto removedPath{ root.begin()->second.getFullPath() };
+    const std::string removedName{ root.begin()->first };
+    navigator.replaceRoot(removedName, std::nullopt);
+    const bool isRebuilt{ index.update(root, navigator.getTreeGeneration()) };
+    std::size_t removedCovered{};
+    for (const auto path : pathViews) {
+        if (path.starts_with(removedPath)) {
+            removedCovered += index.resolve(path).entry != DirectoryQueryIndex::noEntry;
+        }
+    }
+
+    const auto queries{ static_cast<double>(pathViews.size()) };
+    std::printf(
+        "nodes\t%zu\ncomponents\t%zu\nindex_bytes\t%zu\nbuild_ms\t%.1f\n"
+        "\nqueries\t%zu\nexact\t%zu\ncovered\t%zu\nresolve_ms\t%.2f\nns_per_query\t%.0f\nqueries_per_second\t%.0f\n"
+        "\nfind_node_queries\t%zu\nfind_node_found\t%zu\nfind_node_ms\t%.2f\nfind_node_ns_per_query\t%.0f\n"
+        "\ncovered_paths_found\t%zu\nrebuilt_after_removal\t%d\nremoved_covered\t%zu\n",
+        nodes.size(),
+        componentCount,
+        indexBytes,
+        toMilliseconds(buildTime),
+        pathViews.size(),
+        exact,
+        covered,
+        toMilliseconds(resolveTime),
+        toMilliseconds(resolveTime) * 1e6 / queries,
+        queries / (toMilliseconds(resolveTime) / 1000.),
+        nodeQueries,
+        found,
+        toMilliseconds(findTime),
+        toMilliseconds(findTime) * 1e6 / static_cast<double>(std::max<std::size_t>(nodeQueries, 1)),
+        pathsFound,
+        isRebuilt,
+        removedCovered
+    );
+    return pathsFound == covered && isRebuilt && !removedCovered ? 0 : 3;
+}
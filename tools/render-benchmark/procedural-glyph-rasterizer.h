@@ -0,0 +1,99 @@
+#pragma once
+
+#include "software-render-backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Stands in for a font where there is none to rasterize. Every code point
+// gets a few antialiased strokes picked by its hash, sampled 4x4 per pixel
+// like an outline rasterizer would. Advances and line height are the ones
+// FakeTextMeasurer uses, so layouts match the replay harness.
+class ProceduralGlyphRasterizer : public GlyphRasterizer {
+public:
+    explicit ProceduralGlyphRasterizer(const float fontSize)
+        : m_fontSize{ fontSize }
+    {}
+
+    float getLineHeight() const override {
+        return m_fontSize * 1.15f;
+    }
+
+    Metrics rasterize(const char32_t codePoint, std::vector<std::uint8_t>& coverage) override {
+        const auto advance{ m_fontSize * .5f };
+        if (codePoint == U' ') {
+            coverage.clear();
+            return { .advance{ advance } };
+        }
+
+        const Metrics metrics{
+            .advance{ advance },
+            .width{ static_cast<int>(std::ceil(advance)) },
+            .height{ static_cast<int>(std::ceil(m_fontSize * .8f)) },
+            .top{ static_cast<int>(std::lround(m_fontSize * .2f)) },
+        };
+
+        struct Stroke {
+            float x0{};
+            float y0{};
+            float x1{};
+            float y1{};
+        };
+        std::uint64_t state{ (static_cast<std::uint64_t>(codePoint) + 1) * 0x9E3779B97F4A7C15ull };
+        const auto next{ [&state] {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return .1f + .8f * static_cast<float>(state >> 40) / static_cast<float>(1 << 24);
+        } };
+
+        Stroke strokes[4]{};
+        const auto strokeCount{ 2 + static_cast<std::size_t>(codePoint % 3) };
+        for (std::size_t i{}; i < strokeCount; ++i) {
+            strokes[i] = {
+                .x0{ next() * static_cast<float>(metrics.width) },
+                .y0{ next() * static_cast<float>(metrics.height) },
+                .x1{ next() * static_cast<float>(metrics.width) },
+                .y1{ next() * static_cast<float>(metrics.height) },
+            };
+        }
+
+        const auto halfWidth{ std::max(.6f, m_fontSize * .05f) };
+        coverage.assign(static_cast<std::size_t>(metrics.width * metrics.height), 0);
+        for (int y{}; y < metrics.height; ++y) {
+            for (int x{}; x < metrics.width; ++x) {
+                int covered{};
+                for (int sample{}; sample < samples * samples; ++sample) {
+                    const auto sampleX{ static_cast<float>(x) + (static_cast<float>(sample % samples) + .5f) / samples };
+                    const auto sampleY{ static_cast<float>(y) + (static_cast<float>(sample / samples) + .5f) / samples };
+                    for (std::size_t i{}; i < strokeCount; ++i) {
+                        if (getDistance(strokes[i], sampleX, sampleY) <= halfWidth) {
+                            ++covered;
+                            break;
+                        }
+                    }
+                }
+                coverage[static_cast<std::size_t>(y * metrics.width + x)] =
+                    static_cast<std::uint8_t>(covered * 255 / (samples * samples));
+            }
+        }
+        return metrics;
+    }
+
+private:
+    static constexpr int samples{ 4 };
+
+    template<typename Stroke>
+    static float getDistance(const Stroke& stroke, const float x, const float y) {
+        const auto dx{ stroke.x1 - stroke.x0 };
+        const auto dy{ stroke.y1 - stroke.y0 };
+        const auto lengthSquared{ dx * dx + dy * dy };
+        const auto t{ lengthSquared > 0.f
+            ? std::clamp(((x - stroke.x0) * dx + (y - stroke.y0) * dy) / lengthSquared, 0.f, 1.f)
+            : 0.f
+        };
+        return std::hypot(x - (stroke.x0 + t * dx), y - (stroke.y0 + t * dy));
+    }
+
+    const float m_fontSize{};
+};
@@ -0,0 +1,200 @@
+// Draws levels of a generated tree with SoftwareRenderBackend and reports
+// the frame time of entering each level, of redrawing it whole and of
+// moving the selection, which only redraws the two rows that changed.
+//
+// Build from this directory, on Linux with
+//     g++ -std=c++2b -O2 -I../../source -I. render-benchmark.cpp ../../source/directory-view.cpp -o render-benchmark
+//
+// Usage: render-benchmark [--levels N] [--rows N] [--frames N]
+// Level i of N has rows * i / N children, glyphs come from ProceduralGlyphRasterizer.
+
+#include "directory-search-index.h"
+#include "directory-utils.h"
+#include "directory-view.h"
+#include "memory-file-system.h"
+#include "procedural-glyph-rasterizer.h"
+#include "software-render-backend.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    class HeadlessHost : public DirectoryViewHost {
+    public:
+        bool hasFocus() const override {
+            return true;
+        }
+
+        void releaseFocus() override {}
+
+        void resizeWindow(const int, const int) override {}
+
+        void openExplorer(const std::string_view, const bool) override {}
+
+        void writeReport() override {}
+
+        void close() override {}
+    };
+
+    struct Options {
+        std::size_t levels{ 5 };
+        std::size_t rows{ 500 };
+        std::size_t frames{ 200 };
+    };
+
+    bool parseOptions(const int argc, char** const argv, Options& options) {
+        for (int i{ 1 }; i + 1 < argc; i += 2) {
+            const std::string_view argument{ argv[i] };
+            const auto value{ static_cast<std::size_t>(std::strtoull(argv[i + 1], nullptr, 10)) };
+            if (argument == "--levels") {
+                options.levels = std::max<std::size_t>(value, 1);
+            } else if (argument == "--rows") {
+                options.rows = std::max<std::size_t>(value, 1);
+            } else if (argument == "--frames") {
+                options.frames = std::max<std::size_t>(value, 1);
+            } else {
+                return false;
+            }
+        }
+        return argc % 2 == 1;
+    }
+
+    // Names of mixed lengths, some outside ASCII
+    std::string getRowName(const std::size_t row) {
+        static constexpr std::array<std::string_view, 8> words{
+            "src",
+            "Visual Studio 2022",
+            "node_modules",
+            "Zdjęcia z wakacji",
+            "release-notes",
+            "third_party",
+            "Документы",
+            "x",
+        };
+        return std::string{ words[row % words.size()] } + '-' + std::to_string(row);
+    }
+
+    struct Timings {
+        std::vector<std::chrono::nanoseconds> times{};
+
+        template<typename Callback>
+        void measure(const Callback& callback) {
+            const auto start{ std::chrono::steady_clock::now() };
+            callback();
+            times.push_back(std::chrono::steady_clock::now() - start);
+        }
+
+        double getPercentile(const std::size_t percentile) {
+            std::sort(times.begin(), times.end());
+            const auto index{ std::min(times.size() - 1, times.size() * percentile / 100) };
+            return static_cast<double>(times[index].count()) / 1000.;
+        }
+    };
+
+    std::uint64_t getDigest(const std::span<const std::uint32_t> pixels) {
+        std::uint64_t digest{ 14695981039346656037ull };
+        for (const auto pixel : pixels) {
+            digest = (digest ^ pixel) * 1099511628211ull;
+        }
+        return digest;
+    }
+}
+
+int main(const int argc, char** const argv) {
+    Options options{};
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: render-benchmark [--levels N] [--rows N] [--frames N]\n";
+        return 1;
+    }
+
+    std::vector<std::string> paths{};
+    std::string config{};
+    for (std::size_t level{ 1 }; level <= options.levels; ++level) {
+        const auto levelPath{ "A:\\level-" + std::to_string(level) };
+        config += levelPath + "\\*\n";
+        for (std::size_t row{}; row < std::max<std::size_t>(options.rows * level / options.levels, 1); ++row) {
+            paths.push_back(levelPath + '\\' + getRowName(row));
+        }
+    }
+    MemoryFileSystem fileSystem{ paths };
+
+    DirectoryNode root{};
+    root.readFromString(config, nullptr, fileSystem);
+
+    const DirectoryView::StyleConfig styleConfig{};
+    ProceduralGlyphRasterizer rasterizer{ styleConfig.fontSize };
+    SoftwareRenderBackend renderBackend{ rasterizer, styleConfig.backgroundTint };
+    DirectorySearchIndex searchIndex{};
+    DirectoryNavigator navigator{ &root, nullptr, fileSystem };
+    HeadlessHost host{};
+    DirectoryView view{ &navigator, &searchIndex, renderBackend, renderBackend, host, styleConfig };
+
+    std::printf(
+        "level\trows\twidth\theight\tenter_us\tfull_p50_us\tfull_p99_us"
+        "\tpartial_p50_us\tpartial_p99_us\tpartial_matches_full\tdigest\n"
+    );
+    for (std::size_t level{ 1 }; level <= options.levels; ++level) {
+        const auto levelName{ "level-" + std::to_string(level) };
+
+        // A single drive is flattened into the root, so levels are its children
+        const std::string_view names[]{ levelName };
+        if (!navigator.selectPath(names) || !navigator.enterSelected()) {
+            std::cerr << "can't enter " << levelName << '\n';
+            return 1;
+        }
+
+        // Measures the longest name and resizes the frame, the first level also fills the atlas
+        Timings enter{};
+        enter.measure([&] { view.refresh(); });
+
+        Timings full{};
+        for (std::size_t frame{}; frame < options.frames; ++frame) {
+            full.measure([&] { view.drawDirectories(); });
+        }
+
+        Timings partial{};
+        for (std::size_t frame{}; frame < options.frames; ++frame) {
+            partial.measure([&] {
+                view.handleKeyPress({ .key{ DirectoryView::Key::Down } }, InputLatencyRecorder::Clock::now());
+            });
+        }
+
+        // What the partial frames left has to be what a whole frame draws
+        const auto partialDigest{ getDigest(renderBackend.getPixels()) };
+        view.drawDirectories();
+        const auto fullDigest{ getDigest(renderBackend.getPixels()) };
+
+        std::printf(
+            "%s\t%zu\t%d\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%d\t%016llx\n",
+            levelName.c_str(),
+            navigator.getCurrentNode()->getChildCount(),
+            renderBackend.getWidth(),
+            renderBackend.getHeight(),
+            enter.getPercentile(50),
+            full.getPercentile(50),
+            full.getPercentile(99),
+            partial.getPercentile(50),
+            partial.getPercentile(99),
+            partialDigest == fullDigest,
+            static_cast<unsigned long long>(fullDigest)
+        );
+        navigator.enterParent();
+    }
+
+    std::printf(
+        "\nframes\t%llu\natlas_glyphs\t%zu\natlas_bytes\t%zu\n",
+        static_cast<unsigned long long>(renderBackend.getFrameCount()),
+        renderBackend.getAtlas().getGlyphCount(),
+        renderBackend.getAtlas().getMemoryUsage()
+    );
+    return 0;
+}
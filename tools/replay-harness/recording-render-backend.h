@@ -0,0 +1,99 @@
+#pragma once
+
+#include "render-backend.h"
+#include "utf8.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Keeps a digest of every frame instead of pixels, so replays can be compared
+// between builds. Nothing is allocated while drawing once frames are reserved.
+class RecordingRenderBackend : public RenderBackend {
+public:
+    struct Frame {
+        std::uint32_t drawCalls{};
+        std::uint64_t digest{};
+    };
+
+    explicit RecordingRenderBackend(const std::size_t expectedFrames) {
+        m_frames.reserve(expectedFrames);
+    }
+
+    void beginFrame() override {
+        m_frame = { .digest{ fnvOffsetBasis } };
+        mix(static_cast<std::uint64_t>(m_width) << 32 | static_cast<std::uint32_t>(m_height));
+    }
+
+    void drawText(const std::string_view text, const TextArea& area, const TextStyle style) override {
+        ++m_frame.drawCalls;
+        for (const auto character : text) {
+            mix(static_cast<unsigned char>(character));
+        }
+        mix(static_cast<std::uint64_t>(area.top * 64.f));
+        mix(static_cast<std::uint64_t>(area.left * 64.f));
+        mix(static_cast<std::uint64_t>(style));
+    }
+
+    void endFrame() override {
+        m_frames.push_back(m_frame);
+        m_drawCalls += m_frame.drawCalls;
+    }
+
+    void clear() override {}
+
+    void resize(const int width, const int height) override {
+        m_width = width;
+        m_height = height;
+    }
+
+    const std::vector<Frame>& getFrames() const {
+        return m_frames;
+    }
+
+    std::uint64_t getDrawCalls() const {
+        return m_drawCalls;
+    }
+
+    // Of all frames so far, equal digests mean the session looked the same
+    std::uint64_t getSessionDigest() const {
+        std::uint64_t digest{ fnvOffsetBasis };
+        for (const auto& frame : m_frames) {
+            digest = (digest ^ frame.digest) * fnvPrime;
+        }
+        return digest;
+    }
+
+private:
+    void mix(const std::uint64_t value) {
+        m_frame.digest = (m_frame.digest ^ value) * fnvPrime;
+    }
+
+    static constexpr std::uint64_t fnvOffsetBasis{ 14695981039346656037ull };
+    static constexpr std::uint64_t fnvPrime{ 1099511628211ull };
+
+    Frame m_frame{};
+    std::vector<Frame> m_frames{};
+    std::uint64_t m_drawCalls{};
+    int m_width{};
+    int m_height{};
+};
+
+// Every character is as wide as the average Arial glyph at the font size,
+// close enough for window sizes and exactly the same on every machine
+class FakeTextMeasurer : public TextMeasurer {
+public:
+    explicit FakeTextMeasurer(const float fontSize)
+        : m_fontSize{ fontSize }
+    {}
+
+    TextSize measureText(const std::string_view text) override {
+        return {
+            .width{ static_cast<float>(utf8::countCodePoints(text)) * m_fontSize * .5f },
+            .height{ m_fontSize * 1.15f },
+        };
+    }
+
+private:
+    const float m_fontSize{};
+};
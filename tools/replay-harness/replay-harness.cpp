@@ -0,0 +1,531 @@
+// Replays recorded key presses against a synthetic tree without a window
+// and reports the CPU time and allocations of every key press.
+//
+// Build from this directory, on Linux with
+//     g++ -std=c++2b -O2 -DQUICK_FOLDER_COUNT_ALLOCATIONS -I../../source -I. replay-harness.cpp ../../source/directory-view.cpp ../../source/allocation-counter.cpp -o replay-harness
+//
+// Usage: replay-harness [recording] [--drives N] [--areas N] [--projects N] [--fanout N]
+//                       [--keys N] [--latency-us N] [--deadline-ms N] [--budget-kib N]
+//                       [--check-allocations]
+// The recording is written by the app when the config has #record-keys=<path>,
+// without one a session is generated from a fixed seed.
+// The tree is generated in memory, --latency-us delays every file system operation.
+// --deadline-ms is the root deadline of the loader, roots read slower are applied stale
+// first. It fails unless some root was that slow and each one was replaced by its full read.
+// --budget-kib puts the tree under a memory budget and fails if the tree and the
+// search index take more than it, or if search can't find a name inside any level
+// it evicted.
+// With --check-allocations it fails if navigating or redrawing allocated anything.
+// Typing a search runs it over the whole tree and entering a level the budget evicted
+// reads it again, both may allocate and are reported on their own with their allocations.
+
+#include "allocation-counter.h"
+#include "directory-search-index.h"
+#include "directory-utils.h"
+#include "directory-view.h"
+#include "key-recording.h"
+#include "memory-file-system.h"
+#include "recording-render-backend.h"
+#include "tree-loader.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static_assert(AllocationCounter::isEnabled, "build with -DQUICK_FOLDER_COUNT_ALLOCATIONS, allocations wouldn't be counted");
+
+namespace {
+    std::chrono::nanoseconds getThreadCpuTime() {
+#ifdef _WIN32
+        ::FILETIME creation{}, exit{}, kernel{}, user{};
+        ::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user);
+        const auto toTicks{ [](const ::FILETIME time) {
+            return static_cast<std::uint64_t>(time.dwHighDateTime) << 32 | time.dwLowDateTime;
+        } };
+        return std::chrono::nanoseconds{ (toTicks(kernel) + toTicks(user)) * 100 };
+#else
+        ::timespec time{};
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return std::chrono::seconds{ time.tv_sec } + std::chrono::nanoseconds{ time.tv_nsec };
+#endif
+    }
+
+    class HeadlessHost : public DirectoryViewHost {
+    public:
+        bool hasFocus() const override {
+            return m_hasFocus;
+        }
+
+        void releaseFocus() override {
+            m_hasFocus = false;
+        }
+
+        void resizeWindow(const int, const int) override {}
+
+        // Focus comes back right away, unlike a real explorer window taking it
+        void openExplorer(const std::string_view, const bool) override {
+            m_hasFocus = true;
+        }
+
+        void writeReport() override {}
+
+        void close() override {}
+
+    private:
+        bool m_hasFocus{ true };
+    };
+
+    struct Options {
+        std::string recordingPath{};
+        std::size_t drives{ 3 };
+        std::size_t areas{ 12 };
+        std::size_t projects{ 6 };
+        std::size_t fanout{ 40 };
+        std::size_t keys{ 2000 };
+        std::size_t latencyUs{};
+        std::size_t deadlineMs{};
+        std::size_t budgetKib{};
+        bool checkAllocations{};
+    };
+
+    bool parseOptions(const int argc, char** const argv, Options& options) {
+        for (int i{ 1 }; i < argc; ++i) {
+            const std::string_view argument{ argv[i] };
+            if (!argument.starts_with("--")) {
+                options.recordingPath = argument;
+                continue;
+            }
+            if (argument == "--check-allocations") {
+                options.checkAllocations = true;
+                continue;
+            }
+            if (i + 1 >= argc)
+                return false;
+
+            const auto value{ static_cast<std::size_t>(std::strtoull(argv[++i], nullptr, 10)) };
+            if (argument == "--drives") {
+                options.drives = std::clamp<std::size_t>(value, 1, 26);
+            } else if (argument == "--areas") {
+                options.areas = value;
+            } else if (argument == "--projects") {
+                options.projects = value;
+            } else if (argument == "--fanout") {
+                options.fanout = value;
+            } else if (argument == "--keys") {
+                options.keys = value;
+            } else if (argument == "--latency-us") {
+                options.latencyUs = value;
+            } else if (argument == "--deadline-ms") {
+                options.deadlineMs = value;
+            } else if (argument == "--budget-kib") {
+                options.budgetKib = value;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Drive\area\project\* for every combination, so three explicit levels over one enumerated
+    std::string generateConfig(const Options& options) {
+        std::string config{};
+        for (std::size_t drive{}; drive < options.drives; ++drive) {
+            for (std::size_t area{}; area < options.areas; ++area) {
+                for (std::size_t project{}; project < options.projects; ++project) {
+                    config += static_cast<char>('A' + drive);
+                    config += ":\\area-" + std::to_string(area);
+                    config += "\\project-" + std::to_string(project) + "\\*\n";
+                }
+            }
+        }
+        return config;
+    }
+
+    // Mostly moving through levels with some searching, from a fixed seed
+    KeyRecording generateSession(const std::size_t keyCount) {
+        using Key = DirectoryView::Key;
+
+        KeyRecording recording{};
+        std::uint64_t state{ 0x9E3779B97F4A7C15ull };
+        const auto next{ [&state](const std::uint32_t bound) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<std::uint32_t>(state >> 33) % bound;
+        } };
+
+        while (recording.getEvents().size() < keyCount) {
+            const auto roll{ next(100) };
+            if (roll < 55) {
+                const auto key{ next(3) ? Key::Down : Key::Up };
+                for (auto count{ next(6) + 1 }; count; --count) {
+                    recording.recordKeyPress({ .key{ key } });
+                }
+            } else if (roll < 75) {
+                recording.recordKeyPress({ .key{ Key::Right } });
+            } else if (roll < 93) {
+                recording.recordKeyPress({ .key{ Key::Left } });
+            } else {
+                static constexpr std::string_view queries[]{ "proj", "area 3", "photos", "src-1", "notes" };
+                recording.recordKeyPress({ .key{ Key::Tab } });
+                for (const auto character : queries[next(std::size(queries))]) {
+                    recording.recordCharInput(static_cast<char32_t>(character));
+                }
+                recording.recordKeyPress({ .key{ Key::Down } });
+                recording.recordKeyPress({ .key{ next(2) ? Key::Return : Key::Escape } });
+            }
+        }
+        return recording;
+    }
+
+    // These run a search over the whole tree and build its result rows
+    bool isSearchEvent(const KeyRecording::Event& event) {
+        return event.type == KeyRecording::Event::Type::Char
+            || event.keyPress.key == DirectoryView::Key::Backspace;
+    }
+
+    std::string getEventName(const KeyRecording::Event& event) {
+        if (event.type == KeyRecording::Event::Type::Char)
+            return "char";
+
+        std::string name{ DirectoryView::getKeyName(event.keyPress.key) };
+        if (event.keyPress.key == DirectoryView::Key::Letter) {
+            name += ' ';
+            name += event.keyPress.letter;
+        }
+        return name;
+    }
+
+    struct EventResult {
+        std::chrono::nanoseconds cpuTime{};
+        std::uint64_t allocations{};
+        std::uint64_t allocatedBytes{};
+        std::size_t frames{};
+        bool hasReloaded{};
+    };
+
+    struct EventSummary {
+        std::size_t count{};
+        std::vector<std::chrono::nanoseconds> cpuTimes{};
+        std::uint64_t allocations{};
+        std::uint64_t allocatedBytes{};
+    };
+
+    void collectEvictedLevels(DirectoryNode& node, std::vector<DirectoryNode*>& levels) {
+        if (node.isEvicted()) {
+            levels.push_back(&node);
+        }
+        for (auto& [_, child] : node) {
+            collectEvictedLevels(child, levels);
+        }
+    }
+
+    // Searches for the full path of a name inside an evicted level, only the index still has it
+    bool canFindEvictedName(DirectoryNode& level, FileSystem& fileSystem, DirectorySearchIndex& searchIndex) {
+        const auto levelPath{ level.getFullPath() };
+        std::string path{};
+        fileSystem.listDirectories(levelPath, [&](const FileSystem::DirectoryEntry& entry) {
+            if (path.empty() && level.findChild(entry.name) == level.end()) {
+                path = levelPath + entry.name;
+            }
+        });
+        if (path.empty())
+            return false;
+
+        std::string resultPath{};
+        for (const auto& result : searchIndex.search(path, 20)) {
+            resultPath.clear();
+            searchIndex.appendFullPath(result.entry, resultPath);
+            if (resultPath == path)
+                return true;
+        }
+        return false;
+    }
+
+    double toMicroseconds(const std::chrono::nanoseconds time) {
+        return static_cast<double>(time.count()) / 1000.;
+    }
+}
+
+int main(const int argc, char** const argv) {
+    Options options{};
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: replay-harness [recording] [--drives N] [--areas N]"
+            " [--projects N] [--fanout N] [--keys N] [--latency-us N] [--deadline-ms N] [--budget-kib N]"
+            " [--check-allocations]\n";
+        return 1;
+    }
+
+    // Everything the process allocates, by phase
+    AllocationCounter allocationCounter{};
+
+    KeyRecording recording{};
+    if (options.recordingPath.empty()) {
+        recording = generateSession(options.keys);
+    } else {
+        std::ifstream recordingFile{ options.recordingPath };
+        if (!recordingFile) {
+            std::cerr << "can't open " << options.recordingPath << '\n';
+            return 1;
+        }
+        recording = KeyRecording::read(recordingFile);
+    }
+
+    // Every config entry exists, the level they enumerate is named from a word list
+    const auto generateStart{ std::chrono::steady_clock::now() };
+    const MemoryFileSystem::Level levels[]{
+        { .fanout{ options.areas }, .prefix{ "area" } },
+        { .fanout{ options.projects }, .prefix{ "project" } },
+        { .fanout{ options.fanout } },
+    };
+    auto memoryFileSystem{ MemoryFileSystem::generate(options.drives, levels) };
+    DelayedFileSystem fileSystem{ memoryFileSystem, std::chrono::microseconds{ options.latencyUs } };
+    allocationCounter.endPhase("generate");
+
+    // Without a deadline every root is read in full before it's shown
+    const auto loadStart{ std::chrono::steady_clock::now() };
+    const auto deadline{ options.deadlineMs
+        ? std::chrono::milliseconds{ options.deadlineMs }
+        : std::chrono::hours{ 1 }
+    };
+    TreeLoader treeLoader{ generateConfig(options), { .deadline{ deadline } }, fileSystem };
+
+    while (!treeLoader.waitUntilFinished(std::chrono::hours{ 1 })) {}
+    const auto loadEnd{ std::chrono::steady_clock::now() };
+
+    // Updates come in the order they were read. Those before the first replaced root
+    // are what the window showed at the deadline, stale roots among them.
+    auto updates{ treeLoader.takeUpdates() };
+    std::vector<TreeLoader::Updates> updateBatches(1);
+    const auto firstReplaced{ std::find_if(updates.roots.begin(), updates.roots.end(), [](const auto& loadedRoot) {
+        return !loadedRoot.replacedName.empty();
+    }) };
+    if (firstReplaced != updates.roots.end()) {
+        updateBatches.front().roots.assign(
+            std::make_move_iterator(updates.roots.begin()),
+            std::make_move_iterator(firstReplaced)
+        );
+        updates.roots.erase(updates.roots.begin(), firstReplaced);
+        updateBatches.push_back(std::move(updates));
+    } else {
+        updateBatches.front() = std::move(updates);
+    }
+    allocationCounter.endPhase("load");
+
+    const DirectoryView::StyleConfig styleConfig{};
+    DirectoryNode root{ "/", nullptr, treeLoader.getAllocator() };
+    DirectorySearchIndex searchIndex{};
+    std::optional<DirectoryMemoryBudget> memoryBudget{};
+    if (options.budgetKib) {
+        memoryBudget.emplace(options.budgetKib * 1024);
+    }
+    DirectoryNavigator navigator{ &root, memoryBudget ? &*memoryBudget : nullptr, fileSystem };
+    FakeTextMeasurer textMeasurer{ styleConfig.fontSize };
+    RecordingRenderBackend renderBackend{ recording.getEvents().size() * 2 + 16 };
+    HeadlessHost host{};
+    DirectoryView view{ &navigator, &searchIndex, textMeasurer, renderBackend, host, styleConfig };
+
+    // Roots finish in any order and the first one gets the selection, sorted for equal digests
+    const auto countStaleRoots{ [&root] {
+        return static_cast<std::size_t>(std::count_if(root.begin(), root.end(), [](const auto& child) {
+            return child.second.isStale();
+        }));
+    } };
+    std::size_t staleRootsShown{};
+    std::size_t staleRootsReplaced{};
+    for (auto& batch : updateBatches) {
+        std::sort(batch.roots.begin(), batch.roots.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.node && rhs.node && lhs.node->getName() < rhs.node->getName();
+        });
+        for (const auto& loadedRoot : batch.roots) {
+            staleRootsReplaced += !loadedRoot.replacedName.empty();
+        }
+        view.applyTreeUpdates(std::move(batch));
+        staleRootsShown = std::max(staleRootsShown, countStaleRoots());
+    }
+    const auto staleRootsLeft{ countStaleRoots() };
+    std::vector<EventResult> results(recording.getEvents().size());
+    allocationCounter.endPhase("apply");
+
+    for (std::size_t i{}; i < recording.getEvents().size(); ++i) {
+        const auto& event{ recording.getEvents()[i] };
+        const auto framesBefore{ renderBackend.getFrames().size() };
+        const auto countsBefore{ AllocationCounter::getThreadCounts() };
+        const auto reloadsBefore{ memoryBudget ? memoryBudget->getStats().reloads : 0 };
+        const auto cpuTimeBefore{ getThreadCpuTime() };
+
+        if (event.type == KeyRecording::Event::Type::Char) {
+            view.handleCharInput(event.character);
+        } else {
+            view.handleKeyPress(event.keyPress, InputLatencyRecorder::Clock::now());
+        }
+
+        const auto cpuTimeAfter{ getThreadCpuTime() };
+        const auto counts{ AllocationCounter::getThreadCounts() - countsBefore };
+        results[i] = {
+            .cpuTime{ cpuTimeAfter - cpuTimeBefore },
+            .allocations{ counts.allocations },
+            .allocatedBytes{ counts.allocatedBytes },
+            .frames{ renderBackend.getFrames().size() - framesBefore },
+            .hasReloaded{ memoryBudget && memoryBudget->getStats().reloads != reloadsBefore },
+        };
+    }
+    allocationCounter.endPhase("session");
+
+    // The next tree update builds the index again, evicted levels have to survive that.
+    // Only as many names are kept as fit in their share of the budget.
+    std::vector<DirectoryNode*> evictedLevels{};
+    std::size_t searchableEvictedLevels{};
+    if (memoryBudget) {
+        searchIndex.build(root);
+        collectEvictedLevels(root, evictedLevels);
+        for (const auto level : evictedLevels) {
+            searchableEvictedLevels += canFindEvictedName(*level, memoryFileSystem, searchIndex);
+        }
+    }
+
+    std::printf("event\tname\tcpu_us\tallocations\tallocated_bytes\tframes\n");
+    std::vector<std::pair<std::string, EventSummary>> summaries{};
+    std::vector<std::size_t> allocatingEvents{};
+    std::size_t allocatingSearchEvents{};
+    std::uint64_t searchAllocations{};
+    std::size_t allocatingReloadEvents{};
+    std::uint64_t reloadAllocations{};
+    for (std::size_t i{}; i < results.size(); ++i) {
+        const auto name{ getEventName(recording.getEvents()[i]) };
+        const auto& result{ results[i] };
+        if (result.allocations && isSearchEvent(recording.getEvents()[i])) {
+            ++allocatingSearchEvents;
+            searchAllocations += result.allocations;
+        } else if (result.allocations && result.hasReloaded) {
+            ++allocatingReloadEvents;
+            reloadAllocations += result.allocations;
+        } else if (result.allocations) {
+            allocatingEvents.push_back(i);
+        }
+        std::printf(
+            "%zu\t%s\t%.1f\t%llu\t%llu\t%zu\n",
+            i,
+            name.c_str(),
+            toMicroseconds(result.cpuTime),
+            static_cast<unsigned long long>(result.allocations),
+            static_cast<unsigned long long>(result.allocatedBytes),
+            result.frames
+        );
+
+        auto summary{ std::find_if(summaries.begin(), summaries.end(), [&](const auto& entry) {
+            return entry.first == name;
+        }) };
+        if (summary == summaries.end()) {
+            summary = summaries.insert(summaries.end(), { name, {} });
+        }
+        ++summary->second.count;
+        summary->second.cpuTimes.push_back(result.cpuTime);
+        summary->second.allocations += result.allocations;
+        summary->second.allocatedBytes += result.allocatedBytes;
+    }
+
+    std::printf("\nname\tcount\tp50_us\tp99_us\tmax_us\tallocations_per_event\tbytes_per_event\n");
+    for (auto& [name, summary] : summaries) {
+        auto& times{ summary.cpuTimes };
+        std::sort(times.begin(), times.end());
+        const auto count{ static_cast<double>(summary.count) };
+        std::printf(
+            "%s\t%zu\t%.1f\t%.1f\t%.1f\t%.1f\t%.0f\n",
+            name.c_str(),
+            summary.count,
+            toMicroseconds(times[times.size() / 2]),
+            toMicroseconds(times[std::min(times.size() - 1, times.size() * 99 / 100)]),
+            toMicroseconds(times.back()),
+            static_cast<double>(summary.allocations) / count,
+            static_cast<double>(summary.allocatedBytes) / count
+        );
+    }
+
+    std::printf(
+        "\nnodes\t%zu\nsearch_index_bytes\t%zu\nframes\t%zu\ndraw_calls\t%llu\nsession_digest\t%016llx\n",
+        static_cast<std::size_t>(searchIndex.getEntryCount()),
+        searchIndex.getMemoryUsage(),
+        renderBackend.getFrames().size(),
+        static_cast<unsigned long long>(renderBackend.getDrawCalls()),
+        static_cast<unsigned long long>(renderBackend.getSessionDigest())
+    );
+
+    std::printf(
+        "\nfs_directories\t%zu\nfs_bytes\t%zu\ngenerate_ms\t%.1f\nload_ms\t%.1f\n",
+        memoryFileSystem.getDirectoryCount(),
+        memoryFileSystem.getMemoryUsage(),
+        toMicroseconds(loadStart - generateStart) / 1000.,
+        toMicroseconds(loadEnd - loadStart) / 1000.
+    );
+
+    std::printf("\n");
+    std::ostringstream memoryReport{};
+    root.getStringMemoryStats().writeReport(memoryReport);
+    memoryReport << '\n';
+    allocationCounter.writeReport(memoryReport);
+    if (memoryBudget) {
+        memoryReport << '\n';
+        memoryBudget->writeReport(memoryReport);
+    }
+    std::fputs(memoryReport.str().c_str(), stdout);
+
+    if (options.deadlineMs) {
+        std::printf(
+            "\nstale_roots_shown\t%zu\nstale_roots_replaced\t%zu\nstale_roots_left\t%zu\n",
+            staleRootsShown,
+            staleRootsReplaced,
+            staleRootsLeft
+        );
+        if (!staleRootsShown || staleRootsReplaced != staleRootsShown || staleRootsLeft) {
+            std::cerr << "stale roots weren't shown first and then replaced\n";
+            return 4;
+        }
+    }
+
+    if (memoryBudget) {
+        const auto& stats{ memoryBudget->getStats() };
+        std::printf("\nevicted_levels\t%zu\nsearchable_evicted_levels\t%zu\n", evictedLevels.size(), searchableEvictedLevels);
+        if (stats.residentBytes + stats.indexBytes > stats.budgetBytes) {
+            std::cerr << "the tree and the search index take more than the budget\n";
+            return 3;
+        }
+        if (!evictedLevels.empty() && !searchableEvictedLevels) {
+            std::cerr << "search didn't find a name inside any evicted level\n";
+            return 3;
+        }
+    }
+
+    std::printf(
+        "\nallocating_navigation_events\t%zu\nallocating_search_events\t%zu\nsearch_allocations\t%llu"
+        "\nallocating_reload_events\t%zu\nreload_allocations\t%llu\n",
+        allocatingEvents.size(),
+        allocatingSearchEvents,
+        static_cast<unsigned long long>(searchAllocations),
+        allocatingReloadEvents,
+        static_cast<unsigned long long>(reloadAllocations)
+    );
+    if (options.checkAllocations && !allocatingEvents.empty()) {
+        for (const auto i : allocatingEvents) {
+            std::cerr << "event " << i << " (" << getEventName(recording.getEvents()[i]) << ") allocated "
+                << results[i].allocations << " times\n";
+        }
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Checks the UTF-8 helpers and that names outside ASCII compare and search
+// ignoring case, whatever the C locale is.
+//
+// Build from this directory, on Linux with
+//     g++ -std=c++2b -O2 -I../../source utf8-test.cpp -o utf8-test
+//
+// Usage: utf8-test
+// Prints every failed check and exits with 1 if there was one.
+
+#include "directory-search-index.h"
+#include "directory-utils.h"
+#include "memory-file-system.h"
+#include "utf8.h"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+    int failures{};
+
+    void check(const bool isPassed, const char* const description) {
+        if (!isPassed) {
+            std::printf("failed: %s\n", description);
+            ++failures;
+        }
+    }
+
+    bool canFind(DirectorySearchIndex& index, const std::string_view query, const std::string_view name) {
+        for (const auto& result : index.search(query, 16)) {
+            if (index.getName(result.entry) == name)
+                return true;
+        }
+        return false;
+    }
+}
+
+int main() {
+    check(utf8::foldCodePoint(U'Q') == U'q', "ASCII folds");
+    check(utf8::foldCodePoint(U'Ä') == U'ä', "Latin-1 folds");
+    check(utf8::foldCodePoint(U'×') == U'×', "the multiplication sign stays");
+    check(utf8::foldCodePoint(U'Ł') == U'ł', "Latin Extended-A on odd code points folds");
+    check(utf8::foldCodePoint(U'Ś') == U'ś', "Latin Extended-A on even code points folds");
+    check(utf8::foldCodePoint(U'ı') == U'ı', "the dotless i stays");
+    check(utf8::foldCodePoint(U'Ÿ') == U'ÿ', "Y with diaeresis folds into Latin-1");
+    check(utf8::foldCodePoint(U'Ω') == U'ω', "Greek folds");
+    check(utf8::foldCodePoint(U'ς') == U'σ', "final sigma folds");
+    check(utf8::foldCodePoint(U'Ё') == U'ё', "Cyrillic before А folds");
+    check(utf8::foldCodePoint(U'Я') == U'я', "Cyrillic folds");
+    check(utf8::foldCodePoint(U'Ệ') == U'ệ', "Vietnamese folds");
+    check(utf8::foldCodePoint(U'Ｚ') == U'ｚ', "full-width Latin folds");
+    check(utf8::foldCodePoint(U'日') == U'日', "CJK stays");
+
+    check(utf8::equalsIgnoringCase("Żółć", "żÓŁĆ"), "Polish names are equal ignoring case");
+    check(utf8::equalsIgnoringCase("Документы", "ДОКУМЕНТЫ"), "Russian names are equal ignoring case");
+    check(!utf8::equalsIgnoringCase("Żółć", "Zolc"), "letters with and without diacritics differ");
+    check(!utf8::equalsIgnoringCase("Żółć", "żółćx"), "a longer name differs");
+    check(utf8::matchPrefixIgnoringCase("ÉCOLE\\Été", "école\\") == std::string_view{ "ÉCOLE\\" }.size(),
+        "prefix matches in bytes of the text");
+    check(utf8::matchPrefixIgnoringCase("École", "ecole") == std::string_view::npos, "E doesn't match É");
+
+    std::string text{ "a" };
+    utf8::append(text, U'ł');
+    utf8::append(text, U'😀');
+    check(text == "ał😀", "append encodes");
+    check(utf8::countCodePoints(text) == 3, "code points are counted");
+    utf8::popBack(text);
+    check(text == "ał", "popBack removes a whole code point");
+
+    std::size_t pos{};
+    const std::string_view malformed{ "\xC5x" };
+    check(utf8::decode(malformed, pos) == utf8::replacementCharacter && pos == 1, "a cut sequence decodes as U+FFFD");
+
+    // Search folds names and queries the same way
+    const std::vector<std::string> paths{ "A:\\Żółć", "A:\\ÉCOLE", "A:\\Документы", "A:\\ΣΟΦΙΑ" };
+    MemoryFileSystem fileSystem{ paths };
+    DirectoryNode root{};
+    root.readFromString("A:\\*\n", nullptr, fileSystem);
+    DirectorySearchIndex index{};
+    index.build(root);
+    check(canFind(index, "żółć", "Żółć"), "search finds Żółć typed in lower case");
+    check(canFind(index, "ŻÓŁĆ", "Żółć"), "search finds Żółć typed in upper case");
+    check(canFind(index, "école", "ÉCOLE"), "search finds ÉCOLE typed in lower case");
+    check(canFind(index, "документ", "Документы"), "search finds Документы by a lower case prefix");
+    check(canFind(index, "σοφια", "ΣΟΦΙΑ"), "search finds ΣΟΦΙΑ typed in lower case");
+
+    std::printf("%s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}